@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <cctype>
+
+#include "gg.hpp"
+
+// Helper function for reading the number GDB evaluated for a command built by mi_evaluate_long.
+static bool evaluated_long(const MIRecord & result, long & value) {
+  const MIValue & number = result.results["value"];
+  if (result.record_class != "done" || number.string.empty()) {
+    return false;
+  }
+  value = number.to_long(0);
+  return true;
+}
+
+// Helper function for reading the type out of the output of whatis, e.g. "type = int\n".
+static std::string whatis_type(const std::string & output) {
+  std::string prefix = "type = ";
+  size_t start = output.find(prefix);
+  if (start == std::string::npos) {
+    return std::string();
+  }
+
+  std::string type = output.substr(start + prefix.size());
+  while (!type.empty() && isspace(type.back())) {
+    type.pop_back();
+  }
+  return type;
+}
+
+// Helper function for classifying an element type that typedefs were resolved in,
+// e.g. "const unsigned char" or "struct point {", by its whole words.
+static void classify_element_type(const std::string & type, ArrayInfo & info) {
+  static const char * scalar_words[] = {
+    "char", "short", "int", "long", "signed", "unsigned", "bool", "_Bool", "float", "double",
+    "wchar_t", "char8_t", "char16_t", "char32_t", "__int128", "const", "volatile"
+  };
+  info.element_kind = 0;
+  info.element_char = false;
+
+  // Punctuation such as * and { makes words of its own
+  std::vector<std::string> words;
+  for (size_t i = 0; i < type.size(); i++) {
+    if (isalnum(type[i]) || type[i] == '_') {
+      size_t end = i;
+      while (end < type.size() && (isalnum(type[end]) || type[end] == '_')) {
+        end++;
+      }
+      words.push_back(type.substr(i, end - i));
+      i = end - 1;
+    }
+    else if (!isspace(type[i])) {
+      words.push_back(std::string(1, type[i]));
+    }
+  }
+  if (words.empty()) {
+    return;
+  }
+
+  if (words.back() == "*") {
+    info.element_kind = 'x';
+    return;
+  }
+
+  // Enumerations hold integers, whatever names they give them
+  if (words.front() == "enum") {
+    info.element_kind = 'i';
+    return;
+  }
+
+  char kind = 'i';
+  bool character = false;
+  for (const std::string & word : words) {
+    if (std::find(std::begin(scalar_words), std::end(scalar_words), word) == std::end(scalar_words)) {
+      return;
+    }
+    if (word == "float" || word == "double") {
+      kind = 'f';
+    }
+    else if (kind != 'f' && (word == "unsigned" || word == "bool" || word == "_Bool" || 
+          word == "char8_t" || word == "char16_t" || word == "char32_t")) {
+      kind = 'u';
+    }
+    character = character || word == "char" || word == "char8_t";
+  }
+  info.element_kind = kind;
+  info.element_char = character;
+}
+
+void GDB::set_array_expression(const std::string & expression) {
+  array.expression = expression;
+  array_stale = true;
+  array_pages.clear();
+  array_page_requests.clear();
+}
+
+void GDB::request_array_pages(const std::vector<long> & pages) {
+  array_page_requests.insert(array_page_requests.end(), pages.begin(), pages.end());
+}
+
+void GDB::locate_array() {
+  ArrayInfo located;
+  located.expression = array.expression;
+  located.address = 0;
+  located.element_size = 0;
+  located.length = 0;
+  located.element_kind = 0;
+  located.element_char = false;
+  array = located;
+  if (!mi) {
+    array.error = GDB_ARRAY_NEEDS_MI;
+    return;
+  }
+  if (!is_running_program()) {
+    array.error = GDB_NO_ARRAY;
+    return;
+  }
+  if (array.expression.empty()) {
+    array.error = GDB_ARRAY_HINT;
+    return;
+  }
+
+  // Arrays, including artificial ones such as *p@100, are indexed directly.
+  // A std::vector is indexed too, but its elements are found through the
+  // members of libstdc++'s implementation, so both are asked for at once
+  std::string whole = "(" + array.expression + ")";
+  std::string first = whole + "[0]";
+  std::string start = whole + "._M_impl._M_start";
+  std::vector<std::string> commands = {
+    mi_evaluate_long(("&" + first).c_str()),
+    mi_evaluate_long(("sizeof(" + whole + ") / sizeof(" + first + ")").c_str()),
+    mi_evaluate_long(("sizeof(" + first + ")").c_str()),
+    mi_console(std::string(GDB_WHATIS) + " " + first),
+    mi_evaluate_long(start.c_str()),
+    mi_evaluate_long((whole + "._M_impl._M_finish - " + start).c_str()),
+    mi_evaluate_long(("sizeof(*" + start + ")").c_str()),
+    mi_console(std::string(GDB_WHATIS) + " *" + start),
+    mi_console(std::string(GDB_WHATIS) + " " + whole),
+  };
+  std::vector<MIRecord> results;
+  std::vector<std::string> outputs;
+  execute_mi_batch(commands, results, outputs);
+  if (results.size() < commands.size()) {
+    array.error = GDB_NO_ARRAY;
+    return;
+  }
+
+  // The size of a vector divided by the size of an element means nothing, so its members go first
+  size_t found = std::string::npos;
+  for (size_t index : { (size_t) 4, (size_t) 0 }) {
+    if (evaluated_long(results[index], array.address) && 
+        evaluated_long(results[index + 1], array.length) &&
+        evaluated_long(results[index + 2], array.element_size)) {
+      found = index;
+      break;
+    }
+  }
+  if (found == std::string::npos) {
+    // GDB's reason for rejecting the plain array is the one that makes sense to the user
+    std::string message = results[0].results["msg"].string;
+    array.error = message.empty() ? GDB_NO_ARRAY : message;
+    return;
+  }
+  if (array.length < 0 || array.element_size <= 0) {
+    array.error = GDB_NO_ARRAY;
+    return;
+  }
+
+  // The size of a pointer divided by the size of what it points to means nothing either
+  std::string type = found ? std::string() : whatis_type(outputs[8]);
+  std::string resolved = type.empty() ? type : resolve_type(type, whole);
+  if (!resolved.empty() && resolved.back() == '*') {
+    array.error = GDB_ARRAY_POINTER;
+    return;
+  }
+  array.element_type = whatis_type(outputs[found + 3]);
+
+  // Elements are shown according to what their type is once typedefs are resolved
+  if (!array.element_type.empty()) {
+    classify_element_type(resolve_type(array.element_type, found ? "*" + start : first), array);
+  }
+}
+
+std::string GDB::resolve_type(const std::string & name, const std::string & expression) {
+  std::map<std::string, std::string>::iterator found = resolved_types.find(name);
+  if (found != resolved_types.end()) {
+    return found->second;
+  }
+
+  // Only the first line is kept, since structures are followed by their members
+  std::vector<std::string> outputs;
+  std::vector<MIRecord> results;
+  execute_mi_batch({ mi_console(std::string(GDB_PTYPE) + " " + expression) }, results, outputs);
+  std::string type = whatis_type(outputs.front().substr(0, outputs.front().find('\n')));
+  if (!type.empty()) {
+    resolved_types[name] = type;
+  }
+  return type;
+}
+
+ArrayView GDB::read_array() {
+  if (array_stale) {
+    locate_array();
+    array_stale = false;
+    array_generation++;
+
+    // Pages on screen are read again, so that the viewer is not emptied at every stop
+    request_array_pages(array_pages);
+  }
+
+  ArrayView view;
+  view.info = array;
+  view.generation = array_generation;
+  view.big_endian = false;
+
+  std::vector<long> requested;
+  requested.swap(array_page_requests);
+  if (!array.error.empty() || requested.empty()) {
+    return view;
+  }
+  view.big_endian = is_big_endian();
+
+  // Each page is read once, however many rows of it asked
+  std::sort(requested.begin(), requested.end());
+  requested.erase(std::unique(requested.begin(), requested.end()), requested.end());
+  long page_count = (array.length + GG_ARRAY_PAGE_ELEMENTS - 1) / GG_ARRAY_PAGE_ELEMENTS;
+  array_pages.clear();
+
+  // Pages that cannot be read directly are read through GDB in one round trip
+  std::vector<std::string> commands;
+  std::vector<size_t> unread;
+  for (long index : requested) {
+    if (index < 0 || index >= page_count) {
+      continue;
+    }
+    array_pages.push_back(index);
+
+    long first = index * GG_ARRAY_PAGE_ELEMENTS;
+    ArrayPage page;
+    page.index = index;
+    page.bytes.resize(std::min((long) GG_ARRAY_PAGE_ELEMENTS, array.length - first) * array.element_size);
+    long address = array.address + first * array.element_size;
+    if (!read_inferior_memory(address, page.bytes.data(), page.bytes.size())) {
+      unread.push_back(view.pages.size());
+      commands.push_back(std::string(GDB_MI_READ_MEMORY) + " " +
+          std::to_string(address) + " " + std::to_string(page.bytes.size()));
+    }
+    view.pages.push_back(page);
+  }
+
+  if (!commands.empty()) {
+    std::vector<MIRecord> results;
+    std::vector<std::string> outputs;
+    execute_mi_batch(commands, results, outputs);
+    for (size_t i = 0; i < unread.size() && i < results.size(); i++) {
+      ArrayPage & page = view.pages[unread[i]];
+      long address = array.address + page.index * GG_ARRAY_PAGE_ELEMENTS * array.element_size;
+      copy_memory_blocks(results[i], address, page.bytes.data(), page.bytes.size());
+    }
+  }
+  return view;
+}
@@ -1,18 +1,16 @@
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <cerrno>
+#include <cstring>
+#include <chrono>
 
-#include "gg.hpp" 
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
 
-#ifdef __arm__
-  #define ADDITIONAL_STACK_SPACE 4
-#elif defined(__amd64__)
-  #define ADDITIONAL_STACK_SPACE  16
-#elif defined(__i386__)
-  #define ADDITIONAL_STACK_SPACE 8
-#else
-  #define ADDITIONAL_STACK_SPACE 0
-#endif
+#include "gg.hpp" 
 
 // Helper function for determining if a string ends with a certain value.
 bool string_ends_with(std::string const & str, std::string const & ending) {
@@ -41,14 +39,422 @@ std::vector<std::string> split(const std::string &s, char delim) {
     return elems;
 }
 
-GDB::GDB(std::vector<std::string> args) : 
-  process("gdb", args, 
+// Helper function for wrapping a command line command so that MI runs it.
+std::string mi_console(const std::string & command) {
+  return std::string(GDB_MI_CONSOLE) + " " + mi_quote(command);
+}
+
+// Helper function for building an MI command that evaluates an expression as a plain number.
+std::string mi_evaluate_long(const char * expression) {
+  // Casting to long makes GDB print a plain decimal number
+  return std::string(GDB_MI_EVALUATE) + " " + 
+    mi_quote(std::string("(long) (") + expression + ")");
+}
+
+// Helper function for making an MI command run in the given frame of a thread.
+std::string mi_in_frame(const std::string & command, long thread, long level) {
+  // Options go right after the name of the command
+  size_t name_end = std::min(command.find(' '), command.size());
+  std::string options;
+  if (thread) {
+    options.append(" " GDB_MI_THREAD_OPTION " ").append(std::to_string(thread));
+  }
+  options.append(" " GDB_MI_FRAME_OPTION " ").append(std::to_string(level));
+  return command.substr(0, name_end) + options + command.substr(name_end);
+}
+
+// Helper function for building an MI command that reads a stack frame's memory.
+std::string mi_read_stack_frame(const StackFrame * stack_frame) {
+  return std::string(GDB_MI_READ_MEMORY) + " " + 
+    std::to_string(stack_frame->stack_pointer) + " " + 
+    std::to_string(stack_frame->memory_length);
+}
+
+// Helper function for allocating a stack frame holding length bytes from the stack pointer.
+StackFrame * allocate_stack_frame(long stack_pointer, long frame_address, long length, bool big_endian) {
+  // Bytes that are never read are left as zero
+  StackFrame * stack_frame = (StackFrame *) malloc(sizeof(StackFrame)); 
+  stack_frame->stack_pointer = stack_pointer;
+  stack_frame->frame_address = frame_address;
+  stack_frame->memory_length = length;
+  stack_frame->memory = (uint8_t *) calloc(stack_frame->memory_length, 1);
+  stack_frame->big_endian = big_endian;
+  return stack_frame;
+}
+
+// Helper function for allocating a stack frame from the stack pointer up to the
+// canonical frame address, which GDB's unwinder finds whether or not the code
+// keeps a frame pointer. Everything the frame holds lies in between, up to and
+// including the return address on architectures that push it. Returns nullptr
+// with the reason in error if the bounds are unknown or make no sense.
+StackFrame * new_stack_frame(long stack_pointer, long frame_address, bool big_endian, std::string & error) {
+  long stack_frame_length = frame_address - stack_pointer;
+  if (!stack_pointer || !frame_address || stack_frame_length <= 0) {
+    error = GDB_NO_FRAME_ADDRESS;
+    return nullptr;
+  }
+  if (stack_frame_length > GG_STACK_MAX_BYTES) {
+    error = GDB_FRAME_TOO_LARGE;
+    return nullptr;
+  }
+  return allocate_stack_frame(stack_pointer, frame_address, stack_frame_length, big_endian);
+}
+
+// Helper function for reading the canonical frame address out of the output
+// of info frame, e.g. "Stack level 0, frame at 0x7fffffffe0f0:". Returns 0 if there is none.
+long parse_frame_address(const std::string & output) {
+  size_t start = output.find("frame at ");
+  if (start == std::string::npos) {
+    return 0;
+  }
+  return strtol(output.c_str() + start + strlen("frame at "), nullptr, 16);
+}
+
+// Helper function for converting a hex digit to its value.
+int hex_digit_value(char digit) {
+  if (digit >= '0' && digit <= '9') return digit - '0';
+  if (digit >= 'a' && digit <= 'f') return digit - 'a' + 10;
+  if (digit >= 'A' && digit <= 'F') return digit - 'A' + 10;
+  return 0;
+}
+
+void copy_memory_blocks(const MIRecord & result, long address, uint8_t * memory, long length) {
+  // Memory comes back as one or more readable blocks of hex encoded bytes
+  const MIValue & blocks = result.results["memory"];
+  for (size_t i = 0; i < blocks.size(); i++) {
+    const MIValue & block = blocks[i];
+    long offset = block["begin"].to_long(0) - address;
+    const std::string & contents = block["contents"].string;
+    for (size_t j = 0; j + 1 < contents.size(); j += 2) {
+      long index = offset + j / 2;
+      if (index >= 0 && index < length) {
+        memory[index] = hex_digit_value(contents[j]) << 4 | hex_digit_value(contents[j + 1]);
+      }
+    }
+  }
+}
+
+// Helper function for copying the result of -data-read-memory-bytes into a stack frame.
+void fill_stack_frame(StackFrame * stack_frame, const MIRecord & result) {
+  copy_memory_blocks(result, stack_frame->stack_pointer, stack_frame->memory, stack_frame->memory_length);
+}
+
+// Helper function for splitting a disassembly dump into instructions.
+// Returns false if the dump contains no instructions (e.g. GDB printed an error).
+bool parse_disassembly(const std::string & assembly_dump, FunctionDisassembly & function) {
+  std::stringstream assembly_stream(assembly_dump);
+  std::string buffer; 
+  function.executing_line = -1;
+
+  // The header names the function, e.g. "Dump of assembler code for function main:".
+  // Functions split into several parts, such as a .cold part placed before the function,
+  // have each part introduced by e.g. "Address range 0x401000 to 0x401010:"
+  static const std::string header = "Dump of assembler code for function ";
+  static const std::string range_header = "Address range ";
+  bool range_started = true;
+  std::vector<long> addresses;
+  std::vector<std::string> lines;
+  long executing_line = -1;
+
+  // Instruction lines look like "=> 0x0000000000401136 <+4>:\tmov ..."; 
+  // the header and footer lines of the dump are skipped
+  while (std::getline(assembly_stream, buffer, '\n')) {
+    if (!buffer.compare(0, header.size(), header)) {
+      function.function = buffer.substr(header.size(), buffer.rfind(':') - header.size());
+      continue;
+    }
+    if (!buffer.compare(0, range_header.size(), range_header)) {
+      range_started = true;
+      continue;
+    }
+    if (buffer.size() < 5 || buffer.compare(3, 2, "0x")) {
+      continue;
+    }
+
+    // Executing assembly line contains a specific substring 
+    if (!buffer.compare(0, 2, "=>")) {
+      executing_line = lines.size();
+    }
+
+    addresses.push_back(strtol(buffer.c_str() + 3, nullptr, 16));
+    lines.push_back(buffer.substr(3));
+    if (range_started) {
+      function.range_starts.push_back(addresses.back());
+      range_started = false;
+    }
+  }
+
+  // The parts are not necessarily dumped in address order, so the instructions are sorted
+  std::vector<size_t> order(addresses.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&addresses](size_t a, size_t b) {
+    return addresses[a] < addresses[b];
+  });
+  for (size_t i : order) {
+    if ((long) i == executing_line) {
+      function.executing_line = function.lines.size();
+    }
+    function.addresses.push_back(addresses[i]);
+    function.lines.push_back(std::move(lines[i]));
+  }
+
+  return !function.lines.empty();
+}
+
+// Helper function for cutting the lines around the executing instruction out of a disassembly.
+std::string slice_disassembly(const FunctionDisassembly & function, long program_counter) {
+  // Find the executing line from the program counter, falling back on GDB's marker
+  std::vector<long>::const_iterator found = std::upper_bound(
+      function.addresses.begin(), function.addresses.end(), program_counter);
+  long executing_line = function.executing_line;
+  if (found != function.addresses.begin() && *(found - 1) == program_counter) {
+    executing_line = found - function.addresses.begin() - 1;
+  }
+
+  // Relevant lines in the assembly dump 
+  long starting_line = std::max((long) 0, executing_line - GG_FRAME_LINES / 2);
+  long ending_line = std::min((long) function.lines.size(), starting_line + GG_FRAME_LINES);
+
+  // Iterate through all relevant lines and append each to output, marking the executing line
+  std::string assembly;
+  for (long i = starting_line; i < ending_line; i++) {
+    assembly.append(i == executing_line ? "=> " : "   ").append(function.lines[i]).append("\n");
+  }
+
+  return assembly;
+}
+
+// Helper function for naming the function and file of the innermost frame listed by "where",
+// e.g. "main at prog.c" for "#0  main (argc=1) at prog.c:12", leaving out the argument values.
+// Returns an empty string if the frame has no source file.
+std::string frame_location(const std::string & where) {
+  std::string frame = where.substr(0, where.find('\n'));
+  size_t file_index = frame.rfind(" at ");
+  size_t line_index = frame.rfind(':');
+  if (file_index == std::string::npos || line_index == std::string::npos || line_index < file_index) {
+    return std::string();
+  }
+
+  // Frames other than the innermost may start with their address, e.g. "#1  0x401136 in main ()"
+  size_t function_start = frame.find_first_not_of(' ', frame.find(' '));
+  size_t function_end = frame.find(" (", function_start);
+  size_t in_index = frame.find(" in ", function_start);
+  if (in_index < function_end) {
+    function_start = in_index + strlen(" in ");
+  }
+  return frame.substr(function_start, function_end - function_start) +
+      frame.substr(file_index, line_index - file_index);
+}
+
+// Helper function for listing the source lines around a line number.
+// The window matches what "list <line>" prints with the listsize set to GG_FRAME_LINES.
+std::string list_source_window(SourceFile & source_file, long line_number) {
+  long starting_line = std::max((long) 1, line_number - GG_FRAME_LINES / 2);
+  return source_file.get_lines(starting_line, starting_line + GG_FRAME_LINES - 1);
+}
+
+// Helper function for splitting the output of "info locals" or "info args" into
+// variables without children. Lines that do not start a variable continue the
+// value of the previous one, and messages such as "No locals." are dropped.
+std::vector<Variable> parse_variable_lines(const std::string & output, bool is_argument) {
+  std::vector<Variable> variables;
+  for (const std::string & line : split(output, '\n')) {
+    size_t equals = line.find(" = ");
+    if (equals == std::string::npos || line.empty() || isspace(line[0])) {
+      size_t start = line.find_first_not_of(' ');
+      if (!variables.empty() && start != std::string::npos) {
+        variables.back().value.append(" ").append(line.substr(start));
+      }
+      continue;
+    }
+
+    Variable variable;
+    variable.expression = line.substr(0, equals);
+    variable.name = (is_argument ? "arg:" : "local:") + variable.expression;
+    variable.value = line.substr(equals + 3);
+    variable.child_count = 0;
+    variable.has_more = false;
+    variable.is_argument = is_argument;
+    variable.changed = false;
+    variables.push_back(variable);
+  }
+  return variables;
+}
+
+// Helper function for picking the group a register is displayed in from the
+// comma separated groups GDB puts it in.
+std::string register_group(const std::string & groups) {
+  std::vector<std::string> names = split(groups, ',');
+  auto in_group = [&](const char * group) {
+    return std::find(names.begin(), names.end(), group) != names.end();
+  };
+
+  if (in_group(GDB_REGISTER_GROUP_GENERAL)) return GDB_REGISTER_GROUP_GENERAL;
+  if (in_group("vector")) return "vector";
+  if (in_group("float")) return "float";
+  if (in_group("all")) return "system";
+  return "";
+}
+
+// Helper function for reading the output of "maint print register-groups", 
+// whose lines look like " rax  0  0  0  8 int64_t  general,all,save,restore".
+std::vector<Register> parse_register_groups(const std::string & output) {
+  std::vector<Register> registers;
+  for (const std::string & line : split(output, '\n')) {
+    std::istringstream columns(line);
+    std::string name, number, relative, offset, size, type, groups;
+    columns >> name >> number >> relative >> offset >> size >> type >> groups;
+
+    // The header and unnamed registers are skipped
+    if (number.empty() || !isdigit(number[0]) || name == "''") {
+      continue;
+    }
+
+    size_t index = std::stol(number);
+    if (index >= registers.size()) {
+      registers.resize(index + 1, Register());
+    }
+    registers[index].name = name;
+    registers[index].group = register_group(groups);
+    registers[index].size = atol(size.c_str());
+  }
+  return registers;
+}
+
+// Helper function for building the MI command that reads the raw values of registers.
+std::string mi_read_registers(const std::vector<long> & numbers) {
+  std::string command = std::string(GDB_MI_REGISTER_VALUES) + " " + GDB_REGISTER_FORMAT_RAW;
+  for (long number : numbers) {
+    command.append(" ").append(std::to_string(number));
+  }
+  return command;
+}
+
+// Helper function for getting the bytes of a register from its value in hexadecimal:
+// the int8 lanes of a vector, e.g. "{..., v16_int8 = {0x1, 0x0 <repeats 15 times>}, ...}",
+// which are in the target's byte order, or a plain number, e.g. "0x1f80", whose least
+// significant byte comes first whatever the target, as least_significant_first tells.
+bool parse_register_bytes(const std::string & value, long size, std::vector<uint8_t> & bytes,
+    bool & least_significant_first) {
+  bytes.clear();
+  least_significant_first = false;
+  size_t lanes = value.find("_int8 = {");
+  if (lanes != std::string::npos) {
+    const char * cursor = value.c_str() + lanes + strlen("_int8 = {");
+    while (*cursor && *cursor != '}') {
+      char * end;
+      uint8_t byte = strtol(cursor, &end, 16);
+      if (end == cursor) {
+        return false;
+      }
+      bytes.push_back(byte);
+
+      // GDB abbreviates runs of the same lane
+      cursor = end;
+      if (!strncmp(cursor, " <repeats ", strlen(" <repeats "))) {
+        long repeats = strtol(cursor + strlen(" <repeats "), &end, 10);
+        bytes.insert(bytes.end(), std::max(repeats - 1, 0L), byte);
+        cursor = strchr(end, '>') ? strchr(end, '>') + 1 : end;
+      }
+      while (*cursor == ',' || *cursor == ' ') {
+        cursor++;
+      }
+    }
+    return !bytes.empty();
+  }
+
+  if (value.compare(0, 2, "0x")) {
+    return false;
+  }
+  least_significant_first = true;
+  std::string digits = value.substr(2, value.find(' ') == std::string::npos ? std::string::npos : value.find(' ') - 2);
+  for (long end = digits.size(); end > 0; end -= 2) {
+    long start = std::max(end - 2, 0L);
+    bytes.push_back(strtol(digits.substr(start, end - start).c_str(), nullptr, 16));
+  }
+  bytes.resize(std::max(size, (long) bytes.size()), 0);
+  return true;
+}
+
+// Helper function for determining if a user command replaces or restarts the program.
+bool changes_program(const char * command) {
+  // Commands with the shortest abbreviation GDB accepts for them; shorter prefixes that
+  // are ambiguous are still counted, since a needless invalidation only costs a reload
+  static const struct { const char * name; size_t abbreviation; } commands[] = {
+    { "file", 3 }, { "exec-file", 5 }, { "symbol-file", 3 }, { "add-symbol-file", 5 },
+    { "remove-symbol-file", 8 }, { "core-file", 4 }, { "run", 1 }, { "start", 4 },
+    { "starti", 6 }, { "attach", 2 }, { "target", 3 }, { "load", 3 },
+    { "sharedlibrary", 3 }, { "nosharedlibrary", 3 }
+  };
+
+  // Compare the first word of the command, which GDB accepts abbreviated
+  std::string text(command);
+  size_t start = text.find_first_not_of(" \t");
+  if (start == std::string::npos) {
+    return false;
+  }
+  std::string name = text.substr(start, text.find_first_of(" \t", start) - start);
+  for (const auto & program_command : commands) {
+    if (name.size() >= program_command.abbreviation && !strncmp(program_command.name, name.c_str(), name.size())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Inserts the MI interpreter flag after the program name if requested, and the
+// commands turning on non-stop mode, which must run before the program starts.
+static std::vector<std::string> with_interpreter(std::vector<std::string> args, const GDBOptions & options) {
+  if (options.use_mi) {
+    std::vector<std::string> flags = { GDB_MI_INTERPRETER };
+    if (options.non_stop) {
+      flags.insert(flags.end(), { GDB_EXECUTE_OPTION, GDB_SET_MI_ASYNC, GDB_EXECUTE_OPTION, GDB_SET_NON_STOP });
+    }
+    args.insert(args.empty() ? args.begin() : args.begin() + 1, flags.begin(), flags.end());
+  }
+  return args;
+}
+
+GDB::GDB(std::vector<std::string> args, GDBOptions options) : 
+  process(options.gdb_executable, with_interpreter(args, options), 
       redi::pstreams::pstdin | 
       redi::pstreams::pstdout | 
       redi::pstreams::pstderr), 
+  output_pipe(process.rdbuf()->output_descriptor(), GG_PIPE_BUFFER_SIZE),
+  error_pipe(process.rdbuf()->error_descriptor(), GG_PIPE_BUFFER_SIZE),
   saved_line_number(0),
   running_reset_flag(false), 
-  running_program(false) {}
+  running_program(false),
+  mi(options.use_mi),
+  next_token(1),
+  pending_token(-1),
+  inferior_pid(0),
+  selected_thread(0),
+  selected_frame(0),
+  stop_generation(0),
+  all_threads_generation(0),
+  all_threads_running(false),
+  background_token(-1),
+  awaited_thread(0),
+  stopped_thread(0),
+  frame_position_valid(false),
+  options(options),
+  direct_memory_denied(false),
+  big_endian(-1),
+  register_file_loaded(false),
+  register_panels_valid(0),
+  unshown_changes(0),
+  variables_thread(0),
+  variables_frame(0),
+  pretty_printing(false),
+  array_stale(true),
+  array_generation(0),
+  list_size(0),
+  changed_panels(0),
+  poll_calls(0),
+  parse_time(0) {}
 
   GDB::~GDB() {
     process.close();
@@ -60,15 +466,139 @@ void GDB::execute(const char * command) {
 
 void GDB::execute(const char * command, bool set_flags) {
   if (is_alive() && command) {
-    // Pass line directly to process
-    process << command << std::endl;
+    if (mi) {
+      // Hand the line to GDB's console interpreter and remember its token
+      pending_token = execute_mi(mi_console(command));
+
+      // Commands ending with & return at once in non-stop mode, leaving the threads running
+      std::string line(command);
+      line.erase(line.find_last_not_of(" \t") + 1);
+      background_token = string_ends_with(line, "&") ? pending_token : -1;
+    }
+    else {
+      // Pass line directly to process
+      process << command << std::endl;
+    }
 
     // Mark reset flag for running program
     running_reset_flag = set_flags;
+
+    // User commands can move the selected frame
+    if (set_flags) {
+      frame_position_valid = false;
+    }
+
+    // The cached list size is only trusted until the user touches the setting
+    if (set_flags && string_contains(command, "listsize")) {
+      list_size = 0;
+    }
+
+    // Code may be at different addresses after the program is changed or restarted.
+    // A new run also gets a new process ID, and possibly a different architecture,
+    // which MI reports with =thread-group-started but the command line does not
+    if (set_flags && changes_program(command)) {
+      invalidate_code_caches();
+      if (!mi) {
+        inferior_pid = 0;
+        big_endian = -1;
+      }
+    }
+  }
+}
+
+long GDB::execute_mi(const std::string & command) {
+  long token = next_token++;
+  process << token << command << std::endl;
+  return token;
+}
+
+bool GDB::execute_mi_and_read(const std::string & command, MIRecord & result) {
+  IOCounters start = get_io_counters();
+  long token = execute_mi(command);
+
+  // Console output of internal queries is not shown to the user
+  std::ostringstream discard;
+  read_mi_until(token, discard, discard, &result);
+  stats.record(query_name(command), start, get_io_counters());
+
+  return result.type == MI_RECORD_RESULT && result.record_class != "error";
+}
+
+void GDB::execute_mi_batch(const std::vector<std::string> & commands, 
+    std::vector<MIRecord> & results, std::vector<std::string> & outputs) {
+  execute_mi_batch(commands, results, outputs, nullptr);
+}
+
+void GDB::execute_mi_batch(const std::vector<std::string> & commands, 
+    std::vector<MIRecord> & results, std::vector<std::string> & outputs, MIFollowUp follow_up) {
+  results.assign(commands.size(), MIRecord());
+  outputs.assign(commands.size(), std::string());
+  if (!is_alive()) {
+    return;
+  }
+
+  // Follow-up commands are numbered after the batch's own
+  std::vector<MIFollowUpCommand> follow_ups;
+  auto command_at = [&](size_t index) -> const std::string & {
+    return index < commands.size() ? commands[index] : follow_ups[index - commands.size()].command;
+  };
+
+  // Commands are written ahead of their replies, but no further than the window,
+  // so that GDB never blocks on a full output pipe while gg blocks on a full input pipe
+  IOCounters start = get_io_counters();
+  long first_token = next_token;
+  size_t sent = 0;
+  auto send = [&](size_t count) {
+    std::string lines;
+    for (; sent < std::min(count, commands.size() + follow_ups.size()); sent++) {
+      lines.append(std::to_string(next_token++)).append(command_at(sent)).append("\n");
+    }
+    if (!lines.empty()) {
+      process << lines << std::flush;
+    }
+  };
+
+  // GDB answers in order, so each reply is read into the slot of its token,
+  // or handed to the function of its follow-up. A command's time runs from the
+  // batch being sent to its reply, while the bytes, syscalls and parsing since
+  // the previous reply are charged to it
+  IOCounters previous = start;
+  for (size_t i = 0; i < commands.size() + follow_ups.size(); i++) {
+    send(i + GG_MI_BATCH_WINDOW);
+    MIRecord follow_up_result;
+    MIRecord & result = i < commands.size() ? results[i] : follow_up_result;
+    std::ostringstream output;
+    read_mi_until(first_token + i, output, output, &result);
+
+    IOCounters current = get_io_counters();
+    IOCounters charged = previous;
+    charged.time = start.time;
+    stats.record(query_name(command_at(i)), charged, current);
+    previous = current;
+
+    if (i >= commands.size()) {
+      const MIFollowUpCommand & command = follow_ups[i - commands.size()];
+      if (command.on_reply) {
+        std::string text = output.str();
+        command.on_reply(result, text);
+      }
+      continue;
+    }
+    outputs[i] = output.str();
+
+    // Commands that depend on this reply are queued behind the rest of the
+    // batch straight away, rather than waiting for another round trip
+    if (follow_up) {
+      std::vector<MIFollowUpCommand> more = follow_up(i, results[i]);
+      follow_ups.insert(follow_ups.end(), more.begin(), more.end());
+    }
   }
+  stats.record("batch", start, previous);
 }
 
 std::string GDB::execute_and_read(const char * command) {
+  IOCounters start = get_io_counters();
+
   // Call line in GDB 
   execute(command, false);  
 
@@ -77,6 +607,7 @@ std::string GDB::execute_and_read(const char * command) {
 
   // Get result of command
   read_until_prompt(buffer, buffer, true);
+  stats.record(query_name(command), start, get_io_counters());
 
   return buffer.str();
 }
@@ -107,55 +638,424 @@ std::string GDB::examine_and_read(const char * memory_location,
 }
 
 void GDB::read_until_prompt(std::ostream & output_buffer, std::ostream & error_buffer, bool trim_prompt) {
+  // MI output is self-delimiting, so the prompt is never part of the output
+  if (mi) {
+    long token = pending_token;
+    pending_token = -1;
+    read_mi_until(token, output_buffer, error_buffer, nullptr);
+    return;
+  }
+
   // Do non-blocking reads
   bool hit_prompt = false;
+  size_t prompt_length = strlen(GDB_PROMPT);
   while (is_alive() && !hit_prompt) {
     // Read process's error stream and append to error string
-    while (bufsz = process.err().readsome(buf, sizeof(buf))) {
-      std::string error(buf, bufsz);
-      error_buffer << error << std::flush;
-    }
+    read_errors(error_buffer);
 
     // Read process's output stream and append to output string 
-    std::string last_output; // Intermediate buffer used to hold last line of output
-    while (bufsz = process.out().readsome(buf, sizeof(buf))) {
-      std::string output(buf, bufsz);
-
-      // Signal a break if output ends with the prompt
-      std::string combined_output = last_output + output; // Prompt can be split between two lines 
-      if (string_ends_with(combined_output, GDB_PROMPT)) {
-        hit_prompt = true;
-
-        // Trim the prompt from the output if specified
-        if (trim_prompt) {
-          combined_output.erase(combined_output.size() - strlen(GDB_PROMPT), combined_output.size());
-        }
+    output_pipe.fill();
+    BufferView output = output_pipe.contents();
+
+    // Signal a break if output ends with the prompt
+    if (output.length >= prompt_length && 
+        !memcmp(output.data + output.length - prompt_length, GDB_PROMPT, prompt_length)) {
+      hit_prompt = true;
+
+      // Trim the prompt from the output if specified
+      output_buffer.write(output.data, output.length - (trim_prompt ? prompt_length : 0));
+      output_pipe.consume(output.length);
+    }
+    else {
+      // Prompt can be split between two reads, so hold back anything that could start it
+      size_t held = std::min(output.length, prompt_length - 1);
+      while (held && memcmp(output.data + output.length - held, GDB_PROMPT, held)) {
+        held--;
+      }
+
+      output_buffer.write(output.data, output.length - held);
+      output_pipe.consume(output.length - held);
+    }
+    output_buffer << std::flush;
+
+    // Both pipes are drained, so sleep until GDB has more to say
+    if (!hit_prompt) {
+      wait_for_output();
+    }
+  }
+}
+
+void GDB::read_errors(std::ostream & error_buffer) {
+  error_pipe.fill();
+  BufferView error = error_pipe.contents();
+  error_buffer.write(error.data, error.length);
+  error_buffer << std::flush;
+  error_pipe.consume(error.length);
+}
+
+void GDB::wait_for_output() {
+  // A pipe that hung up stays ready forever, so closed pipes are left out
+  // (poll ignores negative descriptors) rather than waking every poll
+  PipeReader * pipes[2] = { &output_pipe, &error_pipe };
+  struct pollfd descriptors[2];
+  descriptors[0].fd = process.rdbuf()->output_descriptor();
+  descriptors[1].fd = process.rdbuf()->error_descriptor();
+  for (int i = 0; i < 2; i++) {
+    descriptors[i].fd = pipes[i]->is_closed() ? -1 : descriptors[i].fd;
+    descriptors[i].events = POLLIN;
+    descriptors[i].revents = 0;
+  }
+
+  // The timeout only exists so that is_alive() gets rechecked if GDB dies
+  // without closing its pipes; interrupted polls are simply retried by the caller
+  poll(descriptors, 2, GG_POLL_TIMEOUT_MS);
+  poll_calls++;
+
+  // Nothing more will come from a pipe that hung up or failed with nothing left to read
+  for (int i = 0; i < 2; i++) {
+    if ((descriptors[i].revents & (POLLHUP | POLLERR | POLLNVAL)) && !(descriptors[i].revents & POLLIN)) {
+      pipes[i]->set_closed();
+    }
+  }
+}
+
+IOCounters GDB::get_io_counters() {
+  IOCounters counters;
+  counters.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  counters.bytes_read = output_pipe.get_bytes_read() + error_pipe.get_bytes_read();
+  counters.syscalls = output_pipe.get_read_calls() + error_pipe.get_read_calls() + poll_calls;
+  counters.parse_time = parse_time;
+  return counters;
+}
 
-        // Next output to print should be the combined output (prevents double printing)
-        last_output = combined_output;
+void GDB::read_mi_until(long token, std::ostream & output_buffer, std::ostream & error_buffer, MIRecord * result) {
+  bool done = false;
+  bool finished = token == -1; // Set once the command's output is complete; the next prompt ends it
+  bool awaiting_stop = false; // Set when the command resumed the inferior
+  bool logged = false; // Set when GDB already explained an error on the log stream
+  MIRecord record;
+
+  while (is_alive() && !done) {
+    // Read process's error stream and append to error string
+    read_errors(error_buffer);
+
+    // Read process's output stream, which is split into records by line 
+    output_pipe.fill();
+
+    BufferView line;
+    while (!done && output_pipe.next_line(line)) {
+      std::chrono::steady_clock::time_point parse_start = std::chrono::steady_clock::now();
+      bool parsed = parse_mi_record(line.data, line.length, record);
+      parse_time += std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - parse_start).count();
+
+      // Anything that is not a record was written by the inferior
+      if (!parsed) {
+        output_buffer.write(line.data, line.length) << '\n';
+        continue;
+      }
+
+      switch (record.type) {
+        case MI_RECORD_PROMPT:
+          done = finished;
+          break;
+        case MI_RECORD_CONSOLE:
+        case MI_RECORD_TARGET:
+          output_buffer << record.record_class;
+          break;
+        case MI_RECORD_LOG:
+          error_buffer << record.record_class;
+          logged = true;
+          break;
+        case MI_RECORD_RESULT:
+          if (record.token != token) {
+            break;
+          }
+          if (record.record_class == "error" && !logged) {
+            error_buffer << record.results["msg"].string << std::endl;
+          }
+          // The console interpreter reports "running" as soon as the inferior resumes,
+          // unless it was resumed in the background
+          awaiting_stop = record.record_class == "running" && token != background_token;
+          awaited_thread = awaiting_stop ? selected_thread : 0;
+          finished = !awaiting_stop;
+
+          // Replies can be large (e.g. thousands of variables), so they are not copied
+          if (result) {
+            std::swap(*result, record);
+          }
+          break;
+        default:
+          handle_mi_async(record);
+
+          // In non-stop mode other threads can stop before the one the command resumed
+          if (awaiting_stop && record.type == MI_RECORD_EXEC && 
+              record.record_class == "stopped") {
+            finished = record.results["stopped-threads"].kind == MIValue::MI_CONST ||
+              record.results["thread-id"].to_long(0) == awaited_thread;
+          }
+
+          // The resumed thread may exit instead of stopping, alone or with the whole
+          // program. No prompt is sure to follow, so the command ends right away
+          if (awaiting_stop && record.type == MI_RECORD_NOTIFY &&
+              (record.record_class == "thread-group-exited" || (record.record_class == "thread-exited" &&
+              record.results["id"].to_long(0) == awaited_thread))) {
+            finished = true;
+            done = true;
+          }
+      }
+    }
+
+    // The partial line (and anything after the prompt we wanted) stays in the reader
+    output_buffer << std::flush;
+    error_buffer << std::flush;
+
+    // Both pipes are drained, so sleep until GDB has more to say
+    if (!done) {
+      wait_for_output();
+    }
+  }
+  awaited_thread = 0;
+}
+
+bool GDB::read_notifications(std::ostream & output_buffer, std::ostream & error_buffer) {
+  if (!mi || !is_alive()) {
+    return false;
+  }
+
+  read_errors(error_buffer);
+  output_pipe.fill();
+
+  // Only whole records are handled; a partial one stays in the reader for later
+  BufferView line;
+  MIRecord record;
+  while (output_pipe.next_line(line)) {
+    if (!parse_mi_record(line.data, line.length, record)) {
+      output_buffer.write(line.data, line.length) << '\n';
+      continue;
+    }
+
+    switch (record.type) {
+      case MI_RECORD_CONSOLE:
+      case MI_RECORD_TARGET:
+        output_buffer << record.record_class;
+        break;
+      case MI_RECORD_LOG:
+        error_buffer << record.record_class;
+        break;
+      case MI_RECORD_PROMPT:
+      case MI_RECORD_RESULT:
+        // No command is waiting for these
+        break;
+      default:
+        handle_mi_async(record);
+    }
+  }
+
+  output_buffer << std::flush;
+  error_buffer << std::flush;
+  return changed_panels != 0;
+}
+
+void GDB::set_threads_running(const MIValue & threads, bool running) {
+  // Threads are tracked as the exceptions to what every thread last did
+  if (threads.kind == MIValue::MI_CONST && (threads.string.empty() || threads.string == "all")) {
+    all_threads_running = running;
+    running_exceptions.clear();
+    all_threads_generation = stop_generation;
+    return;
+  }
+
+  std::vector<long> ids;
+  if (threads.kind == MIValue::MI_CONST) {
+    ids.push_back(threads.to_long(0));
+  }
+  for (const MIValue & thread : threads.values) {
+    ids.push_back(thread.to_long(0));
+  }
+  for (long id : ids) {
+    if (running == all_threads_running) {
+      running_exceptions.erase(id);
+    }
+    else {
+      running_exceptions.insert(id);
+    }
+    thread_generations[id] = stop_generation;
+  }
+}
+
+bool GDB::is_thread_running(long thread) {
+  return all_threads_running != (running_exceptions.count(thread) > 0);
+}
+
+long GDB::get_stop_generation(long thread) {
+  std::map<long, long>::iterator found = thread_generations.find(thread);
+  if (found == thread_generations.end()) {
+    return all_threads_generation;
+  }
+  return std::max(found->second, all_threads_generation);
+}
+
+void GDB::handle_mi_async(const MIRecord & record) {
+  // In non-stop mode threads resume and stop on their own, which only changes
+  // the thread list unless the selected thread is one of them
+  if (record.type == MI_RECORD_EXEC && record.record_class == "running") {
+    const MIValue & threads = record.results["thread-id"];
+    stop_generation++;
+    set_threads_running(threads, true);
+    changed_panels |= threads.string == "all" || threads.to_long(0) == selected_thread ?
+      GG_PANEL_ALL : GG_PANEL_THREADS;
+    return;
+  }
+
+  // Stops report where the inferior stopped, so the frame is known without asking
+  if (record.type == MI_RECORD_EXEC && record.record_class == "stopped") {
+    const MIValue & stopped_threads = record.results["stopped-threads"];
+    long thread = record.results["thread-id"].to_long(selected_thread);
+    stop_generation++;
+    set_threads_running(stopped_threads, false);
+
+    // A thread stopping in non-stop mode leaves the user's selection alone, unless the
+    // selected thread is running on its own and nothing would be shown; the stopped
+    // thread is then selected once no command is being read
+    if (stopped_threads.kind != MIValue::MI_CONST && selected_thread && thread != selected_thread) {
+      changed_panels |= GG_PANEL_THREADS;
+      if (is_thread_running(selected_thread) && selected_thread != awaited_thread) {
+        stopped_thread = thread;
       }
-      else {
-        // Flush last output
-        output_buffer << last_output << std::flush;
+      return;
+    }
+    stopped_thread = 0;
+    changed_panels = GG_PANEL_ALL;
+    set_selected_thread(thread, 0);
+    if (record.results.has("frame")) {
+      cache_frame_position(record.results["frame"]);
+    }
+    return;
+  }
+
+  if (record.type != MI_RECORD_NOTIFY) {
+    return;
+  }
+
+  // Track the inferior's lifetime without asking GDB for it
+  if (record.record_class == "thread-group-started") {
+    running_program = true;
+    inferior_pid = record.results["pid"].to_long(0);
+    all_threads_generation = ++stop_generation;
+    big_endian = -1;
+    invalidate_code_caches();
+  }
+  else if (record.record_class == "thread-group-exited") {
+    running_program = false;
+    inferior_pid = 0;
+    stop_generation++;
+    set_threads_running(MIValue(), false);
+    thread_generations.clear();
+    changed_panels = GG_PANEL_ALL;
+  }
+  // Threads coming and going only change the thread list; the first one is
+  // selected as the program starts, before any of them stops
+  else if (record.record_class == "thread-created" ||
+      record.record_class == "thread-exited") {
+    changed_panels |= GG_PANEL_THREADS;
+    if (!selected_thread && record.record_class == "thread-created") {
+      set_selected_thread(record.results["id"].to_long(0), 0);
+    }
+  }
+  else if (record.record_class == "library-loaded" || 
+      record.record_class == "library-unloaded") {
+    invalidate_code_caches();
+  }
+  // Selecting another frame (frame, up, down) or thread moves what is displayed
+  else if (record.record_class == "thread-selected") {
+    changed_panels |= GG_PANEL_ALL & ~GG_PANEL_THREADS;
+    set_selected_thread(record.results["id"].to_long(selected_thread), record.results["frame"]["level"].to_long(0));
+    register_panels_valid = 0;
+    if (record.results.has("frame")) {
+      cache_frame_position(record.results["frame"]);
+    }
+  }
+  // Memory written by the user (e.g. set var) changes variables and the stack
+  else if (record.record_class == "memory-changed") {
+    changed_panels = GG_PANEL_ALL;
+    all_threads_generation = ++stop_generation;
+  }
+}
 
-        // Set next output to print to be the current output
-        last_output = output;
+void GDB::cache_frame_position(const MIValue & frame) {
+  // Frames without debugging information have no line
+  frame_position.line_number = frame["line"].to_long(0);
+  frame_position.program_counter = frame["addr"].to_long(0);
+  frame_position.source_path = frame["fullname"].string;
+  frame_position_valid = true;
+}
+
+int GDB::take_state_change() {
+  int changed;
+  long line_number = 0;
+  if (mi) {
+    // A thread that stopped while the selected one ran is shown in its place
+    if (stopped_thread) {
+      long thread = stopped_thread;
+      stopped_thread = 0;
+      if (is_thread_running(selected_thread) && !is_thread_running(thread)) {
+        select_thread(thread);
       }
     }
 
-    // Flush last output that wasn't emptied by the loop
-    output_buffer << last_output << std::flush;
+    changed = changed_panels;
+    changed_panels = 0;
+
+    // The frame of a stop is cached from its notification, so this is usually free
+    if ((changed & GG_PANEL_THREAD_BOUND) && is_running_program() && !is_thread_running(selected_thread)) {
+      line_number = get_source_line_number();
+    }
+  }
+  else {
+    // The command line interface has no notifications, so only a new line is noticed
+    line_number = is_running_program() ? get_source_line_number() : 0;
+    changed = line_number != saved_line_number ? GG_PANEL_ALL : 0;
+    if (changed) {
+      all_threads_generation = ++stop_generation;
+    }
+  }
+
+  // The line of the frame is needed to list the source around it, and the
+  // array viewer's array may have moved or changed length
+  if (changed & GG_PANEL_THREAD_BOUND) {
+    saved_line_number = line_number;
+    array_stale = true;
   }
+  return changed;
+}
+
+bool GDB::evaluate_long(const char * expression, long & value) {
+  MIRecord result;
+  if (!execute_mi_and_read(mi_evaluate_long(expression), result)) {
+    return false;
+  }
+
+  const MIValue & number = result.results["value"];
+  if (number.kind != MIValue::MI_CONST || number.string.empty()) {
+    return false;
+  }
+  value = number.to_long(0);
+  return true;
 }
 
 bool GDB::is_alive() {
-  bool exited = 
-    process.out().rdbuf()->exited() || // Check process output buffer
-    process.err().rdbuf()->exited();   // Check process error buffer
-  return !exited;
+  // GDB cannot answer once its output is closed, even before it is seen to exit
+  return !process.rdbuf()->exited() && !output_pipe.is_closed();
 }
 
 bool GDB::is_running_program() {
+  // MI announces the inferior starting and exiting as it happens
+  if (mi) {
+    return running_program;
+  }
+
   if (running_reset_flag) {
     // Collect program status output
     std::string program_status = execute_and_read(GDB_INFO_PROGRAM);
@@ -163,6 +1063,11 @@ bool GDB::is_running_program() {
     // Output with "not being run" only appears when GDB is not running anything
     running_program = !string_contains(program_status, "not being run");
 
+    // A program that exited or was killed takes its process ID with it
+    if (!running_program) {
+      inferior_pid = 0;
+    }
+
     // Set flag to false, execute will reset it
     running_reset_flag = false;
   }
@@ -176,6 +1081,12 @@ std::string GDB::get_source_code() {
     return std::string(GDB_NO_SOURCE_CODE);
   }
 
+  // Source files that can be read are listed without asking GDB
+  SourceFile * source_file = find_source_file(get_source_path());
+  if (source_file && saved_line_number > 0) {
+    return list_source_window(*source_file, saved_line_number);
+  }
+
   // Save the current list size and list line number
   long list_size = get_source_list_size();
 
@@ -197,6 +1108,53 @@ std::string GDB::get_source_code() {
   return source; 
 }
 
+std::string GDB::get_source_path() {
+  if (mi) {
+    // Frame information includes the full path if there is debugging information
+    FramePosition position;
+    return get_frame_position(position) ? position.source_path : std::string();
+  }
+
+  // The path only changes with the function and file of the frame, so GDB is asked once for each
+  std::map<std::string, std::string>::const_iterator found = source_paths.find(source_location);
+  if (!source_location.empty() && found != source_paths.end()) {
+    return found->second;
+  }
+
+  // e.g. "Located in /path/to/program.c"
+  std::string output = execute_and_read(GDB_INFO_SOURCE);
+  size_t located_index = output.find("Located in ");
+  if (located_index == std::string::npos) {
+    return std::string();
+  }
+
+  std::string path = output.substr(located_index + strlen("Located in "));
+  path = path.substr(0, path.find('\n'));
+  if (!source_location.empty()) {
+    source_paths[source_location] = path;
+  }
+  return path;
+}
+
+SourceFile * GDB::find_source_file(const std::string & path) {
+  if (path.empty()) {
+    return nullptr;
+  }
+
+  // Files are only read again when they change on disk, e.g. after an edit
+  std::map<std::string, SourceFile>::iterator found = source_cache.find(path);
+  if (found != source_cache.end() && !found->second.is_stale(path)) {
+    return &found->second;
+  }
+
+  SourceFile & source_file = source_cache[path];
+  if (!source_file.open(path)) {
+    source_cache.erase(path);
+    return nullptr;
+  }
+  return &source_file;
+}
+
 std::string GDB::get_local_variables() {
   // Program is not running
   if (!is_running_program()) {
@@ -234,45 +1192,44 @@ std::string GDB::get_variable_value(const char * variable) {
   return value.substr(split_index + 2, value.size());
 }
 
-StackFrame * GDB::get_stack_frame() {
+StackFrame * GDB::get_stack_frame(std::string & error) {
   // Program is not running
   if (!is_running_program()) {
     return nullptr; 
   }
 
-  // Get raw output from GDB as to the locations of the stack and frame pointers
-  std::string stack_pointer_output = 
-    execute_and_read(GDB_PRINT, GDB_STACK_POINTER);
-  std::string frame_pointer_output = 
-    execute_and_read(GDB_PRINT, GDB_FRAME_POINTER);
-
-  // Cut out the relevant parts of the GDB output
-  long start_offset = strlen(" (void *) ") + 1;
-  long stack_start_index = stack_pointer_output.find('=') + start_offset;
-  long frame_start_index = frame_pointer_output.find('=') + start_offset; 
-  long stack_end_index = stack_pointer_output.find('\n');
-  long frame_end_index = frame_pointer_output.find('\n');
-  std::string stack_pointer_string =
-    stack_pointer_output.substr(stack_start_index, stack_end_index);
-  std::string frame_pointer_string =
-    frame_pointer_output.substr(frame_start_index, frame_end_index);
-
-  // Parse trimmed GDB output into longs
-  long stack_pointer = std::stol(stack_pointer_string, nullptr, 16);
-  long frame_pointer = std::stol(frame_pointer_string, nullptr, 16);
-  long stack_frame_length = frame_pointer - stack_pointer;
-
-  // Stack has negative size when main is finished
-  if (stack_frame_length <= 0) {
+  long stack_pointer = 0;
+  if (mi) {
+    // MI hands back the value directly
+    evaluate_long(GDB_STACK_POINTER, stack_pointer);
+  }
+  else {
+    // Get raw output from GDB as to the location of the stack pointer,
+    // e.g. "$1 = (void *) 0x7fffffffe3d0"
+    std::string stack_pointer_output = 
+      execute_and_read(GDB_PRINT, GDB_STACK_POINTER);
+    size_t stack_start_index = stack_pointer_output.find("0x");
+    if (stack_start_index != std::string::npos) {
+      stack_pointer = strtol(stack_pointer_output.c_str() + stack_start_index, nullptr, 16);
+    }
+  }
+
+  // The frame ends at the address GDB's unwinder gives it, in either mode
+  long frame_address = parse_frame_address(execute_and_read(GDB_INFO_FRAME));
+  StackFrame * stack_frame = new_stack_frame(stack_pointer, frame_address, is_big_endian(), error);
+  if (!stack_frame) {
     return nullptr;
   }
 
-  // Set the stack frame struct parameters 
-  StackFrame * stack_frame = (StackFrame *) malloc(sizeof(StackFrame)); 
-  stack_frame->stack_pointer = stack_pointer;
-  stack_frame->frame_pointer = frame_pointer;
-  stack_frame->memory_length = stack_frame_length + ADDITIONAL_STACK_SPACE;
-  stack_frame->memory = (long *) malloc(stack_frame->memory_length * sizeof(long));
+  // Skip GDB entirely if the kernel lets us read the stack ourselves
+  if (read_stack_frame_directly(stack_frame)) {
+    return stack_frame;
+  }
+
+  if (mi) {
+    read_memory_mi(stack_frame);
+    return stack_frame;
+  }
 
   // Create and execute the GDB memory examine command for the stack
   char examine[100];
@@ -284,7 +1241,7 @@ StackFrame * GDB::get_stack_frame() {
   for(std::string line : split(stack_frame_output, '\n')) {
     for (std::string token : split(line, '\t')) {
       // Ignore tokens that are addresses, since we know the beginning and ending addresses
-      if (!string_ends_with(token, ":")) {
+      if (!string_ends_with(token, ":") && index < stack_frame->memory_length) {
         // Fill the stack frame 
         stack_frame->memory[index++] = std::stol(token, nullptr, 16);
       }
@@ -300,48 +1257,97 @@ std::string GDB::get_assembly_code() {
     return std::string(GDB_NO_ASSEMBLY_CODE);
   }
 
-  // Get full assembly dump
-  std::string assembly_dump = execute_and_read(GDB_DISASSEMBLE);
-  std::stringstream assembly_stream(assembly_dump);
+  // Functions that were already disassembled only need the program counter. Without MI
+  // nothing reports shared libraries being loaded, so code cached at the address is only
+  // reused if the symbol there still names the same function.
+  long program_counter = -1;
+  std::string function_name;
+  if (get_program_counter(program_counter, function_name)) {
+    const FunctionDisassembly * function = find_disassembly(program_counter);
+    if (function && (function_name.empty() || function_name == function->function)) {
+      return slice_disassembly(*function, program_counter);
+    }
+  }
 
-  // Vector holding split lines 
-  std::vector<std::string> assembly_lines; 
-  // Buffer used to hold a line 
-  std::string buffer; 
-  // Index of the line we are looking at
-  int current_line = 0; 
-  // Index of the line GDB is executing
-  int executing_line = 0; 
+  // Get full assembly dump and keep the lines around the executing instruction
+  return cache_disassembly(execute_and_read(GDB_DISASSEMBLE), program_counter);
+}
 
-  // Break assembly dump into separate lines and determine executing line
-  while (std::getline(assembly_stream, buffer, '\n')) {
-    assembly_lines.push_back(buffer);
+bool GDB::get_program_counter(long & program_counter, std::string & function) {
+  if (mi) {
+    FramePosition position;
+    if (!get_frame_position(position)) {
+      return false;
+    }
+    program_counter = position.program_counter;
+    return true;
+  }
 
-    // Executing assembly line contains a specific substring 
-    if (string_contains(buffer, "=>")) {
-      executing_line = current_line;
+  // e.g. "$1 = (void (*)()) 0x401136 <main+4>"
+  std::string output = execute_and_read(GDB_PRINT, GDB_PROGRAM_COUNTER);
+  size_t value_index = output.find("0x");
+  if (value_index == std::string::npos) {
+    return false;
+  }
+  program_counter = strtol(output.c_str() + value_index, nullptr, 16);
+
+  // Symbol without the offset, absent if no symbol covers the address
+  size_t symbol_start = output.find('<', value_index);
+  size_t symbol_end = output.rfind('>');
+  if (symbol_start != std::string::npos && symbol_end != std::string::npos && symbol_end > symbol_start) {
+    function = output.substr(symbol_start + 1, symbol_end - symbol_start - 1);
+    size_t offset = function.rfind('+');
+    if (offset != std::string::npos && offset + 1 < function.size() &&
+        function.find_first_not_of("0123456789", offset + 1) == std::string::npos) {
+      function.erase(offset);
     }
+  }
+  return true;
+}
 
-    current_line++;
+const FunctionDisassembly * GDB::find_disassembly(long address) {
+  // Find the part of a function starting at or before the address, then check the
+  // address is one of its instructions, as it may lie between the function's parts
+  std::map<long, std::shared_ptr<const FunctionDisassembly>>::const_iterator found =
+      disassembly_cache.upper_bound(address);
+  if (found == disassembly_cache.begin()) {
+    return nullptr;
   }
+  found--;
 
-  // Concise assembly string that we want to return
-  std::string assembly;
-  // Relevant starting line in the assembly dump 
-  int starting_line = std::max(1, executing_line - GG_FRAME_LINES / 2);
-  // Relevant ending line in the assembly dump
-  int ending_line = starting_line + GG_FRAME_LINES;
+  const FunctionDisassembly & function = *found->second;
+  if (!std::binary_search(function.addresses.begin(), function.addresses.end(), address)) {
+    return nullptr;
+  }
+  return &function;
+}
 
-  // Iterate through all relevant lines and append each to output 
-  for (int i = starting_line; i < ending_line; i++) {
-    if (i < assembly_lines.size()) {
-      assembly.append(assembly_lines[i]).append("\n");
-    }
+std::string GDB::cache_disassembly(const std::string & assembly_dump, long program_counter) {
+  FunctionDisassembly function;
+  if (!parse_disassembly(assembly_dump, function)) {
+    return assembly_dump;
   }
 
+  // Every part of the function is found by its own start address
+  std::string assembly = slice_disassembly(function, program_counter);
+  std::shared_ptr<const FunctionDisassembly> cached = std::make_shared<FunctionDisassembly>(std::move(function));
+  for (long range_start : cached->range_starts) {
+    disassembly_cache[range_start] = cached;
+  }
   return assembly;
 }
 
+void GDB::invalidate_code_caches() {
+  disassembly_cache.clear();
+  source_cache.clear();
+  source_paths.clear();
+  resolved_types.clear();
+  register_file.clear();
+  thread_register_files.clear();
+  register_file_loaded = false;
+  register_panels_valid = 0;
+}
+
 std::string GDB::get_registers() {
   // Program is not running
   if (!is_running_program()) {
@@ -351,14 +1357,294 @@ std::string GDB::get_registers() {
   return execute_and_read(GDB_INFO_REGISTERS);
 }
 
+bool GDB::load_register_file() {
+  if (!register_file_loaded) {
+    register_file = parse_register_groups(execute_and_read(GDB_MAINT_REGISTER_GROUPS));
+    register_file_loaded = true;
+  }
+  return !register_file.empty();
+}
+
+std::vector<long> GDB::get_register_numbers(const char * group) {
+  std::vector<long> numbers;
+  for (size_t number = 0; number < register_file.size(); number++) {
+    if (register_file[number].group == group) {
+      numbers.push_back(number);
+    }
+  }
+  return numbers;
+}
+
+void GDB::update_register_values(const MIRecord & raw) {
+  for (const MIValue & value : raw.results["register-values"].values) {
+    long number = value["number"].to_long(-1);
+    if (number < 0 || number >= (long) register_file.size()) {
+      continue;
+    }
+
+    // Registers read for the first time are not highlighted
+    Register & reg = register_file[number];
+    reg.changed = reg.changed || (!reg.raw_value.empty() && reg.raw_value != value["value"].string);
+    reg.raw_value = value["value"].string;
+  }
+}
+
+std::vector<long> GDB::get_changed_registers(const MIRecord & result, const char * group) {
+  std::vector<long> numbers;
+  for (const MIValue & changed : result.results["changed-registers"].values) {
+    long number = changed.to_long(-1);
+    if (number >= 0 && number < (long) register_file.size() && register_file[number].group == group) {
+      numbers.push_back(number);
+    }
+  }
+  return numbers;
+}
+
+void GDB::read_registers(const std::string & output, std::vector<long> & changed_lines) {
+  // Registers are compared with the values last shown, which are the ones last read
+  // unless that stop was abandoned
+  bool keep_changes = unshown_changes & GG_PANEL_ASSEMBLY;
+  for (Register & reg : register_file) {
+    reg.changed = reg.changed && (keep_changes || reg.group != GDB_REGISTER_GROUP_GENERAL);
+  }
+
+  // Lines look like "rax            0x1c                28". GDB lists the registers
+  // in order, so each one is looked for from after the one before. The output
+  // is scanned in place, since it comes at every stop
+  size_t next = 0;
+  long line = 0;
+  for (const char * cursor = output.c_str(); *cursor; line++) {
+    const char * name = cursor;
+    const char * name_end = name + strcspn(name, " \n");
+    const char * value = name_end + strspn(name_end, " ");
+    const char * value_end = value + strcspn(value, " \n");
+    cursor = value_end + strcspn(value_end, "\n");
+    cursor += *cursor == '\n';
+
+    for (size_t i = 0; value_end > value && i < register_file.size(); i++) {
+      Register & reg = register_file[(next + i) % register_file.size()];
+      if (reg.name.compare(0, std::string::npos, name, name_end - name)) {
+        continue;
+      }
+
+      // Registers read for the first time are not highlighted
+      bool differs = reg.raw_value.compare(0, std::string::npos, value, value_end - value);
+      reg.changed = reg.changed || (differs && !reg.raw_value.empty());
+      if (differs) {
+        reg.raw_value.assign(value, value_end);
+      }
+      if (reg.changed) {
+        changed_lines.push_back(line);
+      }
+      next = (next + i + 1) % register_file.size();
+      break;
+    }
+  }
+}
+
+std::vector<VectorRegister> GDB::read_vector_registers(const MIRecord * raw) {
+  bool keep_changes = unshown_changes & GG_PANEL_VECTOR;
+  for (Register & reg : register_file) {
+    reg.changed = reg.changed && (keep_changes || reg.group != GDB_REGISTER_GROUP_VECTOR);
+  }
+
+  if (raw && raw->record_class == "done") {
+    update_register_values(*raw);
+    register_panels_valid |= GG_PANEL_VECTOR;
+  }
+
+  std::vector<VectorRegister> registers;
+  for (const Register & reg : register_file) {
+    VectorRegister vector;
+    bool least_significant_first;
+    if (reg.group == GDB_REGISTER_GROUP_VECTOR && 
+        parse_register_bytes(reg.raw_value, reg.size, vector.bytes, least_significant_first)) {
+      vector.name = reg.name;
+      vector.big_endian = !least_significant_first && is_big_endian();
+      vector.changed = reg.changed;
+      registers.push_back(std::move(vector));
+    }
+  }
+  return registers;
+}
+
 long GDB::get_source_list_size() {
+  // The setting rarely changes, so it is only asked for again after a command mentions it
+  if (list_size > 0) {
+    return list_size;
+  }
+
   std::string output = execute_and_read(GDB_GET_LIST_SIZE);
   std::string last_word = output.substr(output.find_last_of(' '), output.size() - 1);
-  return std::stol(last_word); 
+  list_size = std::stol(last_word); 
+  return list_size;
+}
+
+void GDB::read_memory_mi(StackFrame * stack_frame) {
+  MIRecord result;
+  execute_mi_and_read(mi_read_stack_frame(stack_frame), result);
+  fill_stack_frame(stack_frame, result);
+}
+
+bool GDB::get_frame_position(FramePosition & position) {
+  if (frame_position_valid) {
+    position = frame_position;
+    return true;
+  }
+
+  // The stack and frame pointers are only fetched when the stack is shown
+  MIRecord result;
+  execute_mi_and_read(GDB_MI_FRAME_INFO, result);
+  if (!is_alive()) {
+    return false;
+  }
+  cache_frame_position(result.results["frame"]);
+
+  position = frame_position;
+  return true;
+}
+
+long GDB::get_inferior_pid() {
+  if (!is_running_program()) {
+    return 0;
+  }
+
+  // MI reports the process ID when the inferior starts
+  if (mi || inferior_pid) {
+    return inferior_pid;
+  }
+
+  // e.g. "* 1    process 12345     /path/to/program"
+  std::string output = execute_and_read(GDB_INFO_INFERIORS);
+  size_t process_index = output.find("process ");
+  if (process_index != std::string::npos) {
+    inferior_pid = strtol(output.c_str() + process_index + strlen("process "), nullptr, 10);
+  }
+
+  return inferior_pid;
+}
+
+bool GDB::read_inferior_memory(long address, uint8_t * memory, long length) {
+  if (!options.direct_memory || direct_memory_denied || length <= 0) {
+    return false;
+  }
+
+  long pid = get_inferior_pid();
+  if (!pid) {
+    return false;
+  }
+
+  // GDB is our child and the inferior is its child, so ptrace access checks normally pass
+  struct iovec local = { memory, (size_t) length };
+  struct iovec remote = { (void *) address, (size_t) length };
+  ssize_t count = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+  if (count == length) {
+    return true;
+  }
+
+  // A short read (e.g. past the end of a mapping) leaves errno as it was, so
+  // only a failed call says why. Kernels without process_vm_readv can still have /proc/<pid>/mem
+  int error = count == -1 ? errno : 0;
+  if (error == ENOSYS) {
+    std::string path = "/proc/" + std::to_string(pid) + "/mem";
+    int descriptor = open(path.c_str(), O_RDONLY);
+    error = descriptor == -1 ? errno : 0;
+    if (descriptor != -1) {
+      count = pread(descriptor, memory, length, address);
+      error = count == -1 ? errno : 0;
+      close(descriptor);
+      if (count == length) {
+        return true;
+      }
+    }
+  }
+
+  // Stop trying once permission is refused; partial reads still go through GDB
+  if (error == EPERM || error == EACCES) {
+    direct_memory_denied = true;
+  }
+  return false;
+}
+
+bool GDB::read_stack_frame_directly(StackFrame * stack_frame) {
+  return read_inferior_memory(stack_frame->stack_pointer, 
+      stack_frame->memory, stack_frame->memory_length);
+}
+
+std::vector<MIFollowUpCommand> GDB::locate_frames(const MIRecord & list, 
+    const std::string & output, FrameLocations & locations) {
+  // Each frame applied to reports its level and canonical frame address on its first
+  // line, e.g. "Stack level 2, frame at 0x7fffffffe0f0:"
+  const MIValue & frames = list.results["stack"];
+  locations.frame_addresses.assign(frames.size(), 0);
+  for (size_t start = output.find(GDB_FRAME_LEVEL); start != std::string::npos; 
+      start = output.find(GDB_FRAME_LEVEL, start + 1)) {
+    long level = strtol(output.c_str() + start + strlen(GDB_FRAME_LEVEL), nullptr, 10);
+    size_t address = output.find("frame at ", start);
+    if (level >= 0 && level < (long) frames.size() && address < output.find('\n', start)) {
+      locations.frame_addresses[level] = strtol(output.c_str() + address + strlen("frame at "), nullptr, 16);
+    }
+  }
+
+  // Frames it did not get to, e.g. with a GDB older than frame apply, are asked one at a time
+  std::vector<MIFollowUpCommand> commands;
+  for (size_t i = 0; i < frames.size(); i++) {
+    if (!locations.frame_addresses[i]) {
+      commands.push_back({ mi_in_frame(mi_console(GDB_INFO_FRAME), 
+            selected_thread, frames[i]["level"].to_long(i)), [&locations, i](MIRecord &, std::string & frame) {
+          locations.frame_addresses[i] = parse_frame_address(frame);
+        } });
+    }
+  }
+  return commands;
+}
+
+std::vector<FrameBounds> GDB::read_frame_bounds(const MIRecord & list, const FrameLocations & locations) {
+  const MIValue & frames = list.results["stack"];
+  if (!frames.size() || locations.frame_addresses.size() != frames.size()) {
+    return std::vector<FrameBounds>();
+  }
+
+  // Frames that were not located have no bounds and end the stack below
+  std::vector<FrameBounds> bounds;
+  for (size_t i = 0; i < frames.size(); i++) {
+    FrameBounds frame;
+    frame.level = frames[i]["level"].to_long(i);
+    frame.function = frames[i]["func"].string;
+    frame.stack_pointer = i ? locations.frame_addresses[i - 1] : locations.stack_pointer;
+    frame.top = locations.frame_addresses[i];
+    bounds.push_back(frame);
+  }
+
+  // Frames GDB could not unwind end the stack, as do the ones that do not fit
+  for (size_t i = 0; i < bounds.size(); i++) {
+    if (bounds[i].top <= bounds[i].stack_pointer || 
+        bounds[i].top - bounds[0].stack_pointer > GG_STACK_MAX_BYTES) {
+      bounds.resize(i);
+      break;
+    }
+  }
+  return bounds;
+}
+
+bool GDB::is_big_endian() {
+  if (big_endian == -1) {
+    // e.g. "The target endianness is set automatically (currently little endian)."
+    std::string output = execute_and_read(GDB_SHOW_ENDIAN);
+    big_endian = string_contains(output, "big endian");
+  }
+  return big_endian;
 }
 
 long GDB::get_source_line_number() {
+  if (mi) {
+    // Frame information includes the line if there is debugging information
+    FramePosition position;
+    return get_frame_position(position) ? position.line_number : 0;
+  }
+
   std::string output = execute_and_read(GDB_WHERE);
+  source_location = frame_location(output);
 
   // Edge case: program can still be running but 
   // entering stdlib functions does not return line numbers
@@ -370,3 +1656,257 @@ long GDB::get_source_line_number() {
   std::string target_word = target_line.substr(0, target_line.find('\n'));
   return std::stol(target_word);
 }
+
+StopInfo GDB::get_stop_info(int panels) {
+  StopInfo info;
+  info.status = is_running_program() ? GDB_STATUS_RUNNING : GDB_STATUS_IDLE;
+  info.stack_frame = nullptr;
+  info.thread = selected_thread;
+  info.cancelled = false;
+  info.panels = panels;
+
+  // Checked between round trips so that stale stops are abandoned early
+  auto interrupted = [&]() {
+    info.cancelled = is_interrupted();
+    return info.cancelled;
+  };
+
+  // The command line interface cannot tell replies apart, so ask one question at a time
+  if (!mi || !is_running_program()) {
+    if (panels & GG_PANEL_SOURCE) {
+      info.source_code = get_source_code();
+      if (interrupted()) return info;
+      info.variables = parse_variable_lines(get_local_variables(), false);
+      if (interrupted()) return info;
+      std::vector<Variable> arguments = parse_variable_lines(get_formal_parameters(), true);
+      info.variables.insert(info.variables.end(), arguments.begin(), arguments.end());
+      if (interrupted()) return info;
+    }
+    if (panels & GG_PANEL_ASSEMBLY) {
+      info.assembly_code = get_assembly_code();
+      if (interrupted()) return info;
+      info.registers = get_registers();
+      if (interrupted()) return info;
+    }
+    if (panels & GG_PANEL_STACK) {
+      info.stack_frame = get_stack_frame(info.stack_error);
+      if (interrupted()) return info;
+    }
+    if (panels & GG_PANEL_ARRAY) {
+      info.array = read_array();
+    }
+    return info;
+  }
+
+  // In non-stop mode the selected thread can run while the others are stopped,
+  // and there is nothing to read about it but the thread list
+  if (is_thread_running(selected_thread)) {
+    info.status = GDB_STATUS_THREAD_RUNNING;
+    if (panels & GG_PANEL_THREADS) {
+      info.threads = list_threads();
+    }
+    return info;
+  }
+
+  // The thread list does not need a frame, unlike everything else
+  FramePosition position;
+  if (!get_frame_position(position) || interrupted()) {
+    if ((panels & GG_PANEL_THREADS) && !info.cancelled) {
+      info.threads = list_threads();
+    }
+    return info;
+  }
+
+  std::vector<std::string> commands;
+
+  // Source files that can be read are listed locally; otherwise GDB lists
+  // them the same way as get_source_code(), including restoring the list size
+  SourceFile * source_file = nullptr;
+  bool source_listed = false;
+  size_t source_index = commands.size() + 1;
+  size_t variables_index = 0;
+  if (panels & GG_PANEL_SOURCE) {
+    source_file = find_source_file(position.source_path);
+    source_listed = source_file && saved_line_number > 0;
+    if (!source_listed) {
+      long user_list_size = get_source_list_size();
+      long original_line_number = std::max(
+          (long) 1, saved_line_number - user_list_size / 2 - 1);
+      commands.push_back(mi_console(std::string(GDB_SET_LIST_SIZE) + " " + std::to_string(GG_FRAME_LINES)));
+      commands.push_back(mi_console(std::string(GDB_LIST) + " " + std::to_string(saved_line_number)));
+      commands.push_back(mi_console(std::string(GDB_SET_LIST_SIZE) + " 1"));
+      commands.push_back(mi_console(std::string(GDB_LIST) + " " + std::to_string(original_line_number)));
+      commands.push_back(mi_console(std::string(GDB_SET_LIST_SIZE) + " " + std::to_string(user_list_size)));
+    }
+
+    // Locals and arguments are variable objects that GDB updates in place, so
+    // only the ones that changed are sent. The frame's variables are listed
+    // to create and delete them as they come into and go out of scope
+    if (!pretty_printing) {
+      commands.push_back(GDB_MI_PRETTY_PRINTING);
+      pretty_printing = true;
+    }
+    variables_index = commands.size();
+    commands.push_back(GDB_MI_LIST_VARIABLES);
+    commands.push_back(GDB_MI_UPDATE_VARIABLES);
+  }
+
+  // Functions that were already disassembled are sliced locally
+  const FunctionDisassembly * function = nullptr;
+  size_t assembly_index = 0;
+  if (panels & GG_PANEL_ASSEMBLY) {
+    function = find_disassembly(position.program_counter);
+    assembly_index = commands.size();
+    if (!function) {
+      commands.push_back(mi_console(GDB_DISASSEMBLE));
+    }
+  }
+
+  // General registers are few, so "info registers" reads them with both their raw
+  // and natural values in one reply, and the changed ones are found locally.
+  // Vector registers are read by number, so that only the ones that changed are
+  // transferred. GDB compares against the registers it saw when last asked, so
+  // they must be read in full when next shown after being left out
+  bool registers_listed = (panels & (GG_PANEL_ASSEMBLY | GG_PANEL_VECTOR)) && load_register_file();
+  size_t registers_index = commands.size();
+  if (panels & GG_PANEL_ASSEMBLY) {
+    commands.push_back(mi_console(GDB_INFO_REGISTERS));
+  }
+  size_t changed_registers_index = commands.size();
+  size_t vector_values_index = std::string::npos;
+  bool vectors_listed = registers_listed && (panels & GG_PANEL_VECTOR);
+  if (vectors_listed) {
+    commands.push_back(GDB_MI_CHANGED_REGISTERS);
+    if (!(register_panels_valid & GG_PANEL_VECTOR)) {
+      vector_values_index = commands.size();
+      commands.push_back(mi_read_registers(get_register_numbers(GDB_REGISTER_GROUP_VECTOR)));
+    }
+  }
+  else {
+    register_panels_valid &= ~GG_PANEL_VECTOR;
+  }
+
+  // The stack is located in the same round trip as the other queries. The frame
+  // ends at its canonical frame address, as on the command line; only info frame
+  // reports it, -stack-info-frame does not
+  size_t pointers_index = commands.size();
+  if (panels & GG_PANEL_STACK) {
+    commands.push_back(mi_evaluate_long(GDB_STACK_POINTER));
+    commands.push_back(mi_console(GDB_INFO_FRAME));
+  }
+
+  // So is every frame of the thread, when the whole stack is shown. Each frame ends
+  // at its canonical frame address and starts at its callee's, or at the stack pointer
+  // for the innermost frame; info frame is applied to all of them in one command
+  size_t frames_index = commands.size();
+  if (panels & GG_PANEL_WHOLE_STACK) {
+    commands.push_back(std::string(GDB_MI_LIST_FRAMES) + " 0 " + std::to_string(GG_WHOLE_STACK_MAX_FRAMES - 1));
+    commands.push_back(mi_console(std::string(GDB_FRAME_APPLY) + " " + std::to_string(GG_WHOLE_STACK_MAX_FRAMES) + 
+          " " + GDB_FRAME_APPLY_QUIET + " " + GDB_INFO_FRAME));
+    commands.push_back(mi_in_frame(mi_evaluate_long(GDB_STACK_POINTER), selected_thread, 0));
+  }
+
+  // And the threads of the program, all in one reply
+  size_t threads_index = commands.size();
+  if (panels & GG_PANEL_THREADS) {
+    commands.push_back(GDB_MI_THREAD_INFO);
+  }
+
+  // Vector registers whose values are known are read again once GDB says
+  // which changed. Values that turn out the same are not flagged
+  MIRecord changed_vector_values;
+  const MIRecord * vector_values = nullptr;
+  auto read_changed_registers = [&](const MIRecord & result) {
+    std::vector<MIFollowUpCommand> reads;
+    std::vector<long> vector = get_changed_registers(result, GDB_REGISTER_GROUP_VECTOR);
+    if (!vector.empty()) {
+      reads.push_back({ mi_read_registers(vector), [&](MIRecord & values, std::string &) {
+          std::swap(changed_vector_values, values);
+          vector_values = &changed_vector_values;
+        } });
+    }
+    return reads;
+  };
+
+  // Variable objects are created and deleted as soon as the frame's variables
+  // are known, and frames are located as soon as they are listed, while GDB
+  // answers the rest of the batch
+  FrameLocations frame_locations;
+  std::vector<MIRecord> results;
+  std::vector<std::string> outputs;
+  if (!commands.empty()) {
+    execute_mi_batch(commands, results, outputs, [&](size_t index, const MIRecord & result) {
+        if ((panels & GG_PANEL_SOURCE) && index == variables_index) {
+          return sync_variables(result);
+        }
+        if (vectors_listed && index == changed_registers_index && vector_values_index == std::string::npos) {
+          return read_changed_registers(result);
+        }
+        if ((panels & GG_PANEL_WHOLE_STACK) && index == frames_index + 1) {
+          return locate_frames(results[frames_index], outputs[index], frame_locations);
+        }
+        return std::vector<MIFollowUpCommand>();
+      });
+  }
+  if (vector_values_index != std::string::npos) {
+    vector_values = &results[vector_values_index];
+  }
+
+  if (panels & GG_PANEL_SOURCE) {
+    info.source_code = source_listed ? 
+      list_source_window(*source_file, saved_line_number) : outputs[source_index];
+    info.variables = read_variables(results[variables_index + 1]);
+  }
+  if (panels & GG_PANEL_ASSEMBLY) {
+    info.assembly_code = function ? 
+      slice_disassembly(*function, position.program_counter) :
+      cache_disassembly(outputs[assembly_index], position.program_counter);
+    info.registers.swap(outputs[registers_index]);
+    read_registers(info.registers, info.changed_registers);
+  }
+  if (vectors_listed) {
+    info.vector_registers = read_vector_registers(vector_values);
+  }
+  if (panels & GG_PANEL_THREADS) {
+    info.threads = parse_threads(results[threads_index]);
+  }
+
+  // GDB is only asked for the stack, in one more round trip, if it cannot be read directly
+  // The whole stack is read the same way, in one piece from the innermost frame
+  if (panels & GG_PANEL_WHOLE_STACK) {
+    frame_locations.stack_pointer = results[frames_index + 2].results["value"].to_long(0);
+    info.stack_frames = read_frame_bounds(results[frames_index], frame_locations);
+  }
+  if (panels & GG_PANEL_STACK) {
+    long stack_pointer = results[pointers_index].results["value"].to_long(0);
+    long frame_address = parse_frame_address(outputs[pointers_index + 1]);
+    info.stack_frame = info.stack_frames.empty() ? 
+      new_stack_frame(stack_pointer, frame_address, is_big_endian(), info.stack_error) :
+      allocate_stack_frame(info.stack_frames.front().stack_pointer, frame_address, 
+          info.stack_frames.back().top - info.stack_frames.front().stack_pointer, is_big_endian());
+    if (info.stack_frame && !read_stack_frame_directly(info.stack_frame) && !interrupted()) {
+      read_memory_mi(info.stack_frame);
+    }
+  }
+
+  // The array is located and read after the rest, since its pages depend on where it is
+  if ((panels & GG_PANEL_ARRAY) && !interrupted()) {
+    info.array = read_array();
+  }
+
+  // Results that arrive after a newer command is queued are not worth showing;
+  // pages of the array read for nothing are asked for again. GDB has already
+  // moved on from the registers and variables it compared, so what changed is
+  // kept until a stop is shown
+  int compared_panels = (panels & (GG_PANEL_SOURCE | GG_PANEL_ASSEMBLY)) | (vectors_listed ? GG_PANEL_VECTOR : 0);
+  if (interrupted()) {
+    for (const ArrayPage & page : info.array.pages) {
+      array_page_requests.push_back(page.index);
+    }
+    unshown_changes |= compared_panels;
+  }
+  else {
+    unshown_changes &= ~compared_panels;
+  }
+  return info;
+}
@@ -1,5 +1,24 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
 #include <wx/wx.h>
 #include <wx/grid.h>
+#include <wx/notebook.h>
+#include <wx/collpane.h>
+#include <wx/treectrl.h>
+#include <wx/checkbox.h>
+#include <wx/listctrl.h>
 
 #include "../include/pstream.hpp"
 
@@ -10,7 +29,43 @@
 #define GG_LICENSE "GNU GPL v3.0"
 
 #define GG_FRAME_LINES 19
+#define GG_POLL_TIMEOUT_MS 250
+#define GG_NOTIFICATION_POLL_MS 50 // How often an idle worker checks for threads stopping in non-stop mode
+#define GG_PIPE_BUFFER_SIZE 65536
+#define GG_MI_BATCH_WINDOW 256 // Commands of an MI batch written before their replies are read
+#define GG_STACK_GRID_WORDS 4
 #define GG_HISTORY_MAX_LENGTH 1000
+// Panels of the GUI, as flags telling which of them to query.
+#define GG_PANEL_SOURCE 1 // Source code, local variables and parameters
+#define GG_PANEL_ASSEMBLY 2 // Assembly code and registers
+#define GG_PANEL_STACK 4 // Stack frame
+#define GG_PANEL_VECTOR 8 // Vector registers, shown in the assembly tab when expanded
+#define GG_PANEL_ARRAY 16 // Array viewer
+#define GG_PANEL_WHOLE_STACK 32 // Every frame of the thread's stack, shown in the stack tab when selected
+#define GG_PANEL_THREADS 64 // Threads of the program
+#define GG_PANEL_ALL (GG_PANEL_SOURCE | GG_PANEL_ASSEMBLY | GG_PANEL_STACK | GG_PANEL_VECTOR | \
+    GG_PANEL_ARRAY | GG_PANEL_WHOLE_STACK | GG_PANEL_THREADS)
+// Panels showing the selected thread and frame, which are cached for each of them until the program runs
+#define GG_PANEL_THREAD_BOUND (GG_PANEL_SOURCE | GG_PANEL_ASSEMBLY | GG_PANEL_STACK | GG_PANEL_VECTOR | \
+    GG_PANEL_WHOLE_STACK)
+#define GG_HISTOGRAM_PRECISION_BITS 5
+#define GG_VARIABLE_PAGE_SIZE 100 // Children of a variable listed at a time when it is expanded
+#define GG_ARRAY_PAGE_ELEMENTS 256 // Elements of an array read at a time as the array viewer scrolls
+#define GG_WHOLE_STACK_MAX_FRAMES 4096 // Frames of the thread's stack shown at most, innermost first
+#define GG_STACK_MAX_BYTES (1 << 22) // Bytes of a thread's stack read at most, innermost frames first
+#define GG_ARRAY_CACHED_PAGES 16 // Pages of an array the viewer keeps, the least recently shown dropped first
+
+#define GG_OPTION_PREFIX "--gg-"
+#define GG_OPTION_CLI "--gg-cli"
+#define GG_OPTION_NO_DIRECT_MEMORY "--gg-no-direct-memory"
+#define GG_OPTION_STATS_FILE "--gg-stats-file="
+#define GG_OPTION_GDB "--gg-gdb="
+#define GG_OPTION_NON_STOP "--gg-non-stop"
+
+#define GG_DEFAULT_GDB "gdb"
+
+#define GG_COMMAND_STATS "gg-stats"
+#define GG_COMMAND_STATS_RESET "gg-stats reset"
 
 #define GDB_PROMPT "(gdb) " 
 #define GDB_QUIT "quit"
@@ -23,11 +78,49 @@
 #define GDB_INFO_LOCALS "info locals"
 #define GDB_INFO_PROGRAM "info program"
 #define GDB_INFO_REGISTERS "info registers"
+#define GDB_INFO_INFERIORS "info inferiors"
+#define GDB_INFO_SOURCE "info source"
+#define GDB_SHOW_ENDIAN "show endian"
 #define GDB_PRINT "p"
 #define GDB_EXAMINE "x"
+#define GDB_WHATIS "whatis"
+#define GDB_PTYPE "ptype"
+
+#define GDB_MI_INTERPRETER "--interpreter=mi3"
+#define GDB_EXECUTE_OPTION "-ex"
+#define GDB_SET_MI_ASYNC "set mi-async on"
+#define GDB_SET_NON_STOP "set non-stop on"
+#define GDB_MI_PROMPT "(gdb)"
+#define GDB_MI_CONSOLE "-interpreter-exec console"
+#define GDB_MI_FRAME_INFO "-stack-info-frame"
+#define GDB_MI_EVALUATE "-data-evaluate-expression"
+#define GDB_MI_READ_MEMORY "-data-read-memory-bytes"
+#define GDB_MI_CHANGED_REGISTERS "-data-list-changed-registers"
+#define GDB_MI_REGISTER_VALUES "-data-list-register-values --skip-unavailable"
+#define GDB_MAINT_REGISTER_GROUPS "maint print register-groups"
+#define GDB_MI_LIST_VARIABLES "-stack-list-variables --no-values"
+#define GDB_MI_CREATE_VARIABLE "-var-create - @"
+#define GDB_MI_UPDATE_VARIABLES "-var-update --all-values *"
+#define GDB_MI_LIST_CHILDREN "-var-list-children --all-values"
+#define GDB_MI_DELETE_VARIABLE "-var-delete"
+#define GDB_MI_PRETTY_PRINTING "-enable-pretty-printing"
+#define GDB_MI_LIST_FRAMES "-stack-list-frames"
+#define GDB_MI_THREAD_OPTION "--thread"
+#define GDB_MI_FRAME_OPTION "--frame"
+#define GDB_INFO_FRAME "info frame"
+#define GDB_FRAME_APPLY "frame apply"
+#define GDB_FRAME_APPLY_QUIET "-q"
+#define GDB_FRAME_LEVEL "Stack level "
+#define GDB_MI_THREAD_INFO "-thread-info"
+#define GDB_MI_SELECT_THREAD "-thread-select"
+#define GDB_MI_SELECT_FRAME "-stack-select-frame"
 
+#define GDB_PROGRAM_COUNTER "$pc"
 #define GDB_STACK_POINTER "$sp"
-#define GDB_FRAME_POINTER "$fp"
+
+#define GDB_REGISTER_FORMAT_RAW "x"
+#define GDB_REGISTER_GROUP_GENERAL "general"
+#define GDB_REGISTER_GROUP_VECTOR "vector"
 
 #define GDB_MEMORY_TYPE_LONG "x"
 #define GDB_MEMORY_TYPE_INSTRUCTION "i"
@@ -35,41 +128,679 @@
 
 #define GDB_STATUS_IDLE "GDB is idle."
 #define GDB_STATUS_RUNNING "GDB is currently running a program."
+#define GDB_STATUS_THREAD_RUNNING "The selected thread is running."
+#define GG_NON_STOP_NEEDS_MI "Non-stop mode needs GDB/MI, so it is not used with " GG_OPTION_CLI "."
 #define GDB_NO_SOURCE_CODE "No source code information available."
 #define GDB_NO_LOCALS "No local variable information available."
 #define GDB_NO_PARAMS "No parameter information available."
 #define GDB_NO_VARIABLE "No variable information available."
 #define GDB_NO_ASSEMBLY_CODE "No assembly code information available."
 #define GDB_NO_REGISTERS "No register information available."
+#define GDB_NO_VECTOR_REGISTERS "No vector register information available."
+#define GDB_NO_THREADS "No thread information available."
+#define GDB_NO_FRAME_ADDRESS "No stack frame information available: GDB could not unwind the selected frame."
+#define GDB_FRAME_TOO_LARGE "The selected frame is too large to display."
+#define GDB_NO_ARRAY "No array information available."
+#define GDB_ARRAY_NEEDS_MI "The array viewer needs GDB/MI."
+#define GDB_ARRAY_HINT "Enter an array, a std::vector or a pointer with a length such as *p@100."
+#define GDB_ARRAY_POINTER "A pointer needs a length, such as *p@100."
+
+// Custom event type sent from the console to the GUI with a DebugSnapshot payload.
+const wxEventType GDB_EVT_SNAPSHOT_UPDATE = wxNewEventType();
+
+// Macro used for binding snapshot events to wxWidgets frame functions.
+#define EVT_GDB_SNAPSHOT_UPDATE(id, func) \
+  wx__DECLARE_EVT1(GDB_EVT_SNAPSHOT_UPDATE, id, wxThreadEventHandler(func))
+
+// Record types found at the start of a line of GDB/MI output.
+#define MI_RECORD_PROMPT 'p'
+#define MI_RECORD_RESULT '^'
+#define MI_RECORD_EXEC '*'
+#define MI_RECORD_STATUS '+'
+#define MI_RECORD_NOTIFY '='
+#define MI_RECORD_CONSOLE '~'
+#define MI_RECORD_TARGET '@'
+#define MI_RECORD_LOG '&'
+
+// A value in GDB/MI output: a C string constant, a tuple of named values
+// such as {line="12",func="main"}, or a list of (possibly named) values.
+class MIValue {
+  public:
+  enum Kind { MI_CONST, MI_TUPLE, MI_LIST };
+
+  Kind kind; 
+  std::string string; // Contents of a constant
+  std::vector<std::string> names; // Names of children, empty for bare list elements
+  std::vector<MIValue> values; // Children of a tuple or list
+
+  MIValue() : kind(MI_CONST) {}
+
+  // Gets the child with the given name, or an empty constant if there is none.
+  const MIValue & operator[](const char * name) const;
+
+  // Gets the child at the given position, or an empty constant if there is none.
+  const MIValue & operator[](size_t index) const;
+
+  // Returns true if the tuple or list has a child with the given name.
+  bool has(const char * name) const;
+
+  // Returns the number of children in the tuple or list.
+  size_t size() const {
+    return values.size();
+  }
+
+  // Parses a constant as a decimal or 0x-prefixed number.
+  long to_long(long fallback) const;
+};
+
+// A single parsed line of GDB/MI output.
+typedef struct {
+  char type; // One of the MI_RECORD_* values
+  long token; // Token of the command that caused this record, or -1
+  std::string record_class; // Result/async class (e.g. "done"), or the text of a stream record
+  MIValue results; // Tuple of results that follow the class
+} MIRecord;
 
-// Custom event types sent from the console to the GUI for updates.
-const wxEventType GDB_EVT_STATUS_BAR_UPDATE = wxNewEventType();
-const wxEventType GDB_EVT_SOURCE_CODE_UPDATE = wxNewEventType();
-const wxEventType GDB_EVT_LOCALS_UPDATE = wxNewEventType();
-const wxEventType GDB_EVT_PARAMS_UPDATE = wxNewEventType();
-const wxEventType GDB_EVT_ASSEMBLY_CODE_UPDATE = wxNewEventType();
-const wxEventType GDB_EVT_REGISTERS_UPDATE = wxNewEventType();
-const wxEventType GDB_EVT_STACK_FRAME_UPDATE = wxNewEventType();
+// Parses one line of GDB/MI output, returning false if it is not a record
+// (e.g. output written by the inferior to the shared terminal).
+bool parse_mi_record(const char * line, size_t length, MIRecord & record);
+
+// Command sent after a reply of an MI batch, with the function that receives
+// its own reply and console output, which it may take. The function may be empty.
+typedef struct {
+  std::string command;
+  std::function<void(MIRecord &, std::string &)> on_reply;
+} MIFollowUpCommand;
+
+// Gets the commands to send after the reply at a given index of an MI batch.
+typedef std::function<std::vector<MIFollowUpCommand>(size_t, const MIRecord &)> MIFollowUp;
+
+// Quotes and escapes a string so that it can be passed as an MI parameter.
+std::string mi_quote(const std::string & value);
+
+// Wraps a command line command so that MI runs it.
+std::string mi_console(const std::string & command);
+
+// Builds an MI command that evaluates an expression as a plain number.
+std::string mi_evaluate_long(const char * expression);
+
+// Makes an MI command run in the given frame of a thread (0 for the selected
+// thread), without changing the frame the user selected.
+std::string mi_in_frame(const std::string & command, long thread, long level);
+
+// Copies the memory in GDB's reply to -data-read-memory-bytes into a buffer
+// of length bytes starting at address. Bytes GDB could not read are left alone.
+void copy_memory_blocks(const MIRecord & result, long address, uint8_t * memory, long length);
 
 // Represents a location in memory.
 typedef struct {
   long stack_pointer;
-  long frame_pointer; 
-  long * memory;
+  long frame_address; // Canonical frame address found by GDB's unwinder, where the frame ends
+  uint8_t * memory; // memory_length bytes starting at the stack pointer
   long memory_length;
+  bool big_endian; // Byte order of the inferior, used to assemble words
 } StackFrame;
 
+// Frees a heap-allocated StackFrame and its memory.
+inline void delete_stack_frame(StackFrame * stack_frame) {
+  if (stack_frame) {
+    free(stack_frame->memory);
+    free(stack_frame);
+  }
+}
+
+// Typed view over a contiguous buffer of inferior memory.
+// Words are assembled in the inferior's byte order, not the host's.
+class MemoryView {
+  const uint8_t * bytes;
+  long length;
+  bool big_endian;
+  public:
+  MemoryView(const uint8_t * bytes, long length, bool big_endian) :
+    bytes(bytes), length(length), big_endian(big_endian) {}
+
+  // Reads an unsigned word of 1, 2, 4 or 8 bytes at the given offset.
+  // Bytes past the end of the buffer read as zero.
+  uint64_t word(long offset, int size) const {
+    uint64_t value = 0;
+    for (int i = 0; i < size; i++) {
+      int index = big_endian ? i : size - 1 - i;
+      uint8_t byte = offset + index < length ? bytes[offset + index] : 0;
+      value = (value << 8) | byte;
+    }
+    return value;
+  }
+
+  uint8_t u8(long offset) const {
+    return (uint8_t) word(offset, 1);
+  }
+
+  uint16_t u16(long offset) const {
+    return (uint16_t) word(offset, 2);
+  }
+
+  uint32_t u32(long offset) const {
+    return (uint32_t) word(offset, 4);
+  }
+
+  uint64_t u64(long offset) const {
+    return word(offset, 8);
+  }
+};
+
+// Stream buffer connected to the GDB process.
+// Exposes the pipe descriptors that pstreams keeps to itself so they can be polled.
+class GDBStreamBuf : public redi::pstreambuf {
+  public:
+  GDBStreamBuf(const std::string & file, const argv_type & argv, pmode mode) :
+    redi::pstreambuf(file, argv, mode) {}
+
+  // Gets the descriptor of the process's output pipe.
+  int output_descriptor() {
+    return rpipe(rsrc_out);
+  }
+
+  // Gets the descriptor of the process's error pipe.
+  int error_descriptor() {
+    return rpipe(rsrc_err);
+  }
+};
+
+// Stream opened to the GDB process.
+// Only its input side is used; output is read through PipeReader.
+class GDBStream : public std::iostream {
+  GDBStreamBuf streambuf;
+  public:
+  GDBStream(const std::string & file, const redi::pstreams::argv_type & argv, redi::pstreams::pmode mode) :
+    std::iostream(nullptr), streambuf(file, argv, mode) {
+    init(&streambuf);
+  }
+
+  GDBStreamBuf * rdbuf() {
+    return &streambuf;
+  }
+
+  // Closes the pipes and waits for the process to exit.
+  void close() {
+    streambuf.close();
+  }
+};
+
+// A window into a PipeReader's buffer, valid until the reader is next filled.
+typedef struct {
+  const char * data;
+  size_t length;
+} BufferView;
+
+// Reads one of GDB's pipes straight into a large buffer with non-blocking
+// read() calls, rather than going through the 32 byte buffers of pstreams.
+// The buffer is linear: consumed bytes are reclaimed by moving the rest to the
+// front rather than by wrapping around, so that every line can be viewed in place.
+class PipeReader {
+  int descriptor; // Pipe being read, switched to non-blocking on construction
+  char * buffer; // Buffer holding unconsumed output
+  size_t capacity; // Size of the buffer, doubled when a single line outgrows it
+  size_t initial_capacity; // Size the buffer starts at, and shrinks back to once a long line is consumed
+  size_t start; // Offset of the first unconsumed byte
+  size_t end; // Offset one past the last byte read
+  bool closed; // Set once the pipe reaches EOF or fails
+  uint64_t bytes_read; // Total bytes read from the pipe, for statistics
+  uint64_t read_calls; // Total read() calls made on the pipe, for statistics
+  public:
+  // Constructor takes over reading the descriptor.
+  PipeReader(int descriptor, size_t capacity);
+
+  // Destructor frees the buffer; the descriptor belongs to the stream.
+  ~PipeReader();
+
+  PipeReader(const PipeReader &) = delete;
+  PipeReader & operator=(const PipeReader &) = delete;
+
+  // Reads everything currently available without blocking.
+  // Returns the number of bytes read.
+  size_t fill();
+
+  // Takes the next complete line out of the buffer (without its newline).
+  // Returns false if no complete line has been read yet.
+  bool next_line(BufferView & line);
+
+  // Gets all unconsumed bytes.
+  BufferView contents() {
+    BufferView view = { buffer + start, end - start };
+    return view;
+  }
+
+  // Marks bytes at the front of the buffer as consumed.
+  void consume(size_t length) {
+    start += length;
+  }
+
+  // Returns true once the pipe has been closed by GDB.
+  bool is_closed() {
+    return closed;
+  }
+
+  // Marks the pipe closed, once poll() reports it hung up or failed with nothing left to read.
+  void set_closed() {
+    closed = true;
+  }
+
+  // Gets the total number of bytes read from the pipe.
+  uint64_t get_bytes_read() {
+    return bytes_read;
+  }
+
+  // Gets the total number of read() calls made on the pipe.
+  uint64_t get_read_calls() {
+    return read_calls;
+  }
+};
+
+// Histogram of durations in microseconds, in the style of HdrHistogram:
+// every power of two is split into 2^GG_HISTOGRAM_PRECISION_BITS linear
+// buckets, so values are recorded to within about 3% in a fixed amount of space.
+class LatencyHistogram {
+  std::vector<uint64_t> counts; // Number of values recorded in each bucket
+  uint64_t total_count;
+  uint64_t minimum;
+  uint64_t maximum;
+  uint64_t sum;
+  public:
+  LatencyHistogram();
+
+  // Records a single value.
+  void record(uint64_t value);
+
+  // Gets the value below which the given percentage (0 to 100) of values fall.
+  uint64_t percentile(double percentage) const;
+
+  uint64_t count() const {
+    return total_count;
+  }
+
+  uint64_t min() const {
+    return total_count ? minimum : 0;
+  }
+
+  uint64_t max() const {
+    return maximum;
+  }
+
+  uint64_t total() const {
+    return sum;
+  }
+
+  uint64_t mean() const {
+    return total_count ? sum / total_count : 0;
+  }
+};
+
+// Running totals of the work done talking to GDB. A snapshot is taken before
+// and after a query so the difference can be attributed to it.
+typedef struct {
+  uint64_t time; // Steady clock time in nanoseconds
+  uint64_t bytes_read; // Bytes read from GDB's pipes
+  uint64_t syscalls; // read() and poll() calls made on GDB's pipes
+  uint64_t parse_time; // Nanoseconds spent parsing MI records
+} IOCounters;
+
+// Statistics collected for every query of the same kind.
+typedef struct {
+  LatencyHistogram wall_time; // Microseconds from sending the query to reading its reply
+  LatencyHistogram parse_time; // Microseconds spent parsing the reply
+  uint64_t bytes_read;
+  uint64_t syscalls;
+} QueryStats;
+
+// Latency statistics for every kind of query sent to GDB, plus the
+// user-facing steps (running a command, refreshing the GUI) around them.
+class GDBStats {
+  std::map<std::string, QueryStats> queries; // Statistics by query name
+  public:
+  // Attributes the work done between two snapshots to the named query.
+  void record(const std::string & name, const IOCounters & start, const IOCounters & end);
+
+  // Forgets everything recorded so far.
+  void reset() {
+    queries.clear();
+  }
+
+  // Prints a table of the queries, the most expensive in total first.
+  void print(std::ostream & output) const;
+
+  // Writes every query's statistics as a JSON object.
+  void write_json(std::ostream & output) const;
+};
+
+// Gets the name a command is recorded under in GDBStats: the command with
+// its arguments and format letters removed, e.g. "print" or "x", and an MI
+// command without its options, e.g. "-var-create" or "-data-list-register-values".
+// The commands of several words gg sends keep them all, e.g. "info locals".
+// Commands wrapped for MI's console interpreter are named by the wrapped command.
+std::string query_name(const std::string & command);
+
+// Source file read into memory, with the offset of every line indexed so
+// that any window of lines can be listed without asking GDB.
+class SourceFile {
+  std::string contents; // Contents of the file, empty if it is not open
+  time_t modified; // Modification time when the file was read
+  std::vector<size_t> line_offsets; // Offset of the first byte of each line
+  public:
+  SourceFile();
+
+  // Reads the file at the given path and indexes its lines.
+  // Returns false if the file cannot be opened.
+  bool open(const std::string & path);
+
+  // Frees the file's contents.
+  void close();
+
+  // Returns true if the file on disk was changed or removed since it was read.
+  bool is_stale(const std::string & path);
+
+  // Gets the number of lines in the file.
+  long line_count() {
+    return line_offsets.size();
+  }
+
+  // Gets the lines from first to last (1-based, inclusive) in the format of
+  // GDB's list command. The range is clamped to the lines in the file.
+  std::string get_lines(long first, long last);
+};
+
+// Options given to gg itself rather than passed through to GDB.
+typedef struct {
+  bool use_mi; // Talk to GDB through GDB/MI rather than its command line interface
+  bool direct_memory; // Read the inferior's memory with process_vm_readv when permitted
+  std::string stats_file; // File the latency statistics are written to on exit, if not empty
+  std::string gdb_executable; // GDB executable to start, looked up in PATH
+  bool non_stop; // Start GDB in non-stop mode, where each thread stops and runs on its own (MI only)
+} GDBOptions;
+
+// Vector register split into bytes, so that the GUI can show its lanes in any format.
+typedef struct {
+  std::string name;
+  std::vector<uint8_t> bytes; // Contents in lane order, starting with lane 0
+  bool big_endian; // Byte order of the lanes
+  bool changed; // Set if the value changed at the last stop
+} VectorRegister;
+
+inline bool operator==(const VectorRegister & a, const VectorRegister & b) {
+  return a.name == b.name && a.bytes == b.bytes && a.big_endian == b.big_endian && a.changed == b.changed;
+}
+
+// Local variable or argument of the selected frame, or one of their children.
+// With MI each is a variable object that GDB keeps up to date between stops,
+// and children are only listed once the user expands their parent.
+typedef struct {
+  std::string name; // Name of the variable object, e.g. "var3.x", or "local:x" without MI
+  std::string parent; // Name of the parent's variable object, empty for locals and arguments
+  std::string expression; // Shown in front of the value, e.g. "x" or "[12]"
+  std::string type;
+  std::string value; // Value as GDB prints it, e.g. "{...}" for structures
+  long child_count; // Number of children; pretty-printed containers may have more (see has_more)
+  bool has_more; // Set if a pretty-printed container has children beyond those listed
+  std::vector<std::string> children; // Names of the children listed so far, in order
+  bool is_argument;
+  bool changed; // Set if the value changed at the last stop
+} Variable;
+
+inline bool operator==(const Variable & a, const Variable & b) {
+  return a.name == b.name && a.parent == b.parent && a.expression == b.expression &&
+    a.type == b.type && a.value == b.value && a.child_count == b.child_count &&
+    a.has_more == b.has_more && a.children == b.children &&
+    a.is_argument == b.is_argument && a.changed == b.changed;
+}
+
+// Frame of a thread's stack and the bytes it occupies. Stacks grow down, so
+// a frame's callers are at higher addresses.
+typedef struct {
+  long level; // 0 for the innermost frame
+  std::string function; // Empty if GDB does not know
+  long stack_pointer; // Lowest address of the frame
+  long top; // One past the highest address of the frame, the canonical frame address
+} FrameBounds;
+
+// Where the frames listed by -stack-list-frames start and end, filled in as GDB answers.
+typedef struct {
+  long stack_pointer; // Stack pointer of the innermost frame, where the others start from
+  std::vector<long> frame_addresses; // Canonical frame address of each listed frame, 0 until GDB answers
+} FrameLocations;
+
+inline bool operator==(const FrameBounds & a, const FrameBounds & b) {
+  return a.level == b.level && a.function == b.function &&
+    a.stack_pointer == b.stack_pointer && a.top == b.top;
+}
+
+// Thread of the program as GDB lists it.
+typedef struct {
+  long id; // GDB's number of the thread
+  std::string target_id; // e.g. "Thread 0x7ffff7d8a740 (LWP 4242)"
+  std::string name; // Name the program gave the thread, empty if none
+  std::string state; // "stopped" or "running"
+  std::string function; // Function of the innermost frame, empty if unknown or running
+  std::string location; // e.g. "main.cpp:42", empty if unknown or running
+} InferiorThread;
+
+inline bool operator==(const InferiorThread & a, const InferiorThread & b) {
+  return a.id == b.id && a.target_id == b.target_id && a.name == b.name &&
+    a.state == b.state && a.function == b.function && a.location == b.location;
+}
+
+// Gets the threads in GDB's reply to -thread-info.
+std::vector<InferiorThread> parse_threads(const MIRecord & result);
+
+// Array shown in the array viewer, located by GDB once per stop.
+typedef struct {
+  std::string expression; // As the user entered it
+  std::string element_type; // e.g. "int", empty if GDB cannot tell
+  char element_kind; // 'i' for signed, 'u' for unsigned, 'f' for floating point, 'x' for pointers or 0 if not a scalar
+  bool element_char; // Set if the elements are characters, e.g. "const char" or "unsigned char"
+  long address; // Address of the first element
+  long element_size; // Bytes in each element
+  long length; // Number of elements
+  std::string error; // Why the expression cannot be shown, empty if it can
+} ArrayInfo;
+
+inline bool operator==(const ArrayInfo & a, const ArrayInfo & b) {
+  return a.expression == b.expression && a.element_type == b.element_type &&
+    a.element_kind == b.element_kind && a.element_char == b.element_char &&
+    a.address == b.address && a.element_size == b.element_size &&
+    a.length == b.length && a.error == b.error;
+}
+
+// Consecutive elements of an array, read from the inferior in one piece.
+typedef struct {
+  long index; // Page number; the page starts at element index * GG_ARRAY_PAGE_ELEMENTS
+  std::vector<uint8_t> bytes; // Contents, shorter than a full page at the end of the array
+} ArrayPage;
+
+inline bool operator==(const ArrayPage & a, const ArrayPage & b) {
+  return a.index == b.index && a.bytes == b.bytes;
+}
+
+// What a refresh of the array viewer read. Only the pages asked for since the
+// last refresh are included, since the viewer keeps the ones it already has.
+typedef struct {
+  ArrayInfo info;
+  long generation; // Changes whenever pages read before are out of date
+  bool big_endian; // Byte order of the elements
+  std::vector<ArrayPage> pages;
+} ArrayView;
+
+inline bool operator==(const ArrayView & a, const ArrayView & b) {
+  return a.info == b.info && a.generation == b.generation &&
+    a.big_endian == b.big_endian && a.pages == b.pages;
+}
+
+// Everything the GUI displays about the point GDB is stopped at.
+typedef struct {
+  std::string status;
+  std::string source_code;
+  std::vector<Variable> variables; // Locals and arguments, each followed by its listed children
+  std::string assembly_code;
+  std::string registers;
+  std::vector<long> changed_registers; // Lines of registers whose value changed since the previous stop
+  std::vector<VectorRegister> vector_registers;
+  StackFrame * stack_frame; // Heap-allocated, or nullptr if there is no frame
+  std::string stack_error; // Why there is no frame although the program is running, or empty
+  std::vector<FrameBounds> stack_frames; // Every frame in stack_frame when the whole stack is shown
+  ArrayView array;
+  std::vector<InferiorThread> threads;
+  long thread; // GDB's number of the thread the other fields are about, or 0 if not known
+  bool cancelled; // Set if the queries were abandoned because a newer command is waiting
+  int panels; // GG_PANEL_* flags of the panels whose fields were queried
+} StopInfo;
+
+// Text of one section of a snapshot, shared between snapshots while it is unchanged.
+typedef std::shared_ptr<const std::string> SnapshotText;
+
+// Everything the GUI displays about a stop, published to the GUI in a single
+// event so that it never shows sections of different stops side by side.
+// Snapshots are not modified once built. A section that did not change since
+// the previous snapshot points to the same object, so the GUI can tell what to
+// redraw by comparing pointers. Sections are nullptr until first queried.
+typedef struct {
+  SnapshotText status;
+  SnapshotText source_code;
+  std::shared_ptr<const std::vector<Variable>> variables;
+  SnapshotText assembly_code;
+  SnapshotText registers;
+  std::shared_ptr<const std::vector<long>> changed_registers; // Lines of registers to highlight
+  std::shared_ptr<const std::vector<VectorRegister>> vector_registers;
+  std::shared_ptr<const StackFrame> stack_frame; // nullptr if there is no frame
+  SnapshotText stack_error;
+  std::shared_ptr<const std::vector<FrameBounds>> stack_frames; // Frames of the whole stack
+  std::shared_ptr<const ArrayView> array;
+  std::shared_ptr<const std::vector<InferiorThread>> threads;
+  long thread; // GDB's number of the thread the snapshot shows, or 0 if not known
+} DebugSnapshot;
+
+typedef std::shared_ptr<const DebugSnapshot> DebugSnapshotPtr;
+
+// Builds the snapshot of a stop from the info queried for it, taking over its
+// stack frame. Panels that were not queried keep the previous snapshot's sections.
+DebugSnapshotPtr make_snapshot(const DebugSnapshotPtr & previous, StopInfo & info);
+
+// Builds a snapshot from one that was cached for a thread, with the sections
+// that do not belong to a thread (status, thread list, array) of the latest one.
+DebugSnapshotPtr reuse_snapshot(const DebugSnapshotPtr & cached, const DebugSnapshotPtr & latest);
+
+// Snapshot cached for a thread's frame.
+typedef struct {
+  DebugSnapshotPtr snapshot;
+  int panels; // GG_PANEL_THREAD_BOUND panels whose sections are current
+  long generation; // Stop generation of the thread when it was cached
+} ThreadSnapshot;
+
+// Snapshots of the threads and frames shown since each thread last ran, so
+// that selecting one of them again is shown without asking GDB. Only used by
+// the worker thread.
+class SnapshotCache {
+  long generation; // Stop generation at which every thread last ran
+  std::map<std::pair<long, long>, ThreadSnapshot> snapshots; // By thread and frame level
+  public:
+  SnapshotCache() : generation(-1) {}
+
+  // Gets the snapshot cached for a thread's frame at the thread's stop generation,
+  // or nullptr, and the panels it holds. Every snapshot is dropped once all of
+  // the threads ran, and a thread's snapshots are ignored once it ran on its own.
+  DebugSnapshotPtr find(long all_threads_generation, long thread_generation,
+      long thread, long frame, int & panels);
+
+  // Marks panels out of date in every cached snapshot, such as the source
+  // panel once variable objects gained children that it does not show.
+  void drop_panels(int panels);
+
+  // Caches the snapshot of a thread's frame, whose given panels are current.
+  void store(long thread_generation, long thread, long frame, int panels, const DebugSnapshotPtr & snapshot);
+};
+
+// Position of the selected frame, fetched in one round trip and reused by later queries.
+typedef struct {
+  long line_number; // 0 if there is no line information
+  long program_counter;
+  std::string source_path; // Full path of the frame's source file, empty if unknown
+} FramePosition;
+
+// Disassembly of a whole function, split into instructions.
+typedef struct {
+  std::vector<std::string> lines; // Instruction lines without the "=>" marker
+  std::vector<long> addresses; // Address of each instruction, in ascending order
+  std::vector<long> range_starts; // First address of each contiguous part of the function
+  long executing_line; // Line that had the "=>" marker when disassembled, or -1
+  std::string function; // Name from the dump header, empty if unknown
+} FunctionDisassembly;
+
+// Register of the inferior, kept between stops to tell which ones changed.
+typedef struct {
+  std::string name; // Empty for register numbers GDB does not use
+  std::string raw_value; // Value in hexadecimal, empty until read
+  std::string group; // One of "general", "vector", "float" or "system", or empty if not displayed
+  long size; // Size in bytes
+  bool changed; // Set if the raw value changed at the last stop
+} Register;
+
 // GDB process abstraction.
 class GDB {
-  redi::pstream process; // The bidirectional stream opened to the process
-  char buf[BUFSIZ]; // Temporary buffer used to read output and error 
-  std::streamsize bufsz; // Number of characters written to temporary buffer at a time
+  GDBStream process; // The stream used to write commands to the process
+  PipeReader output_pipe; // Reader of the process's output
+  PipeReader error_pipe; // Reader of the process's error
   bool running_program; // Cached value specifying if the user is debugging a program in GDB
   bool running_reset_flag; // Set to true when the value of running_program needs to be updated
   long saved_line_number; // The last known line we executed
+  bool mi; // True if GDB speaks GDB/MI instead of its command line interface
+  long next_token; // Token given to the next MI command
+  long pending_token; // Token of the MI command whose result has not been read, or -1
+  long inferior_pid; // Process ID of the inferior as reported by MI, or 0
+  long selected_thread; // GDB's number of the thread last stopped or selected, or 0 if not known
+  long selected_frame; // Level of the frame last selected, 0 after a stop
+  long stop_generation; // Incremented whenever a thread may have run or the program's memory changed
+  long all_threads_generation; // Stop generation at which every thread last may have run
+  std::map<long, long> thread_generations; // Stop generation at which a thread last ran on its own, by thread
+  bool all_threads_running; // Whether the threads are running, apart from those in running_exceptions
+  std::set<long> running_exceptions; // Threads that stopped while the others run, or run while the others are stopped
+  long background_token; // Token of the last user command that resumed threads in the background, or -1
+  long awaited_thread; // Thread whose stop ends the foreground command being read in non-stop mode, or 0
+  long stopped_thread; // Thread that stopped while the selected one was running on its own, or 0
+  FramePosition frame_position; // Cached position of the selected frame
+  bool frame_position_valid; // Cleared whenever a user command may have moved the frame
+  GDBOptions options; // Options gg was started with
+  bool direct_memory_denied; // Set once the kernel refuses direct reads of the inferior
+  int big_endian; // Cached byte order of the inferior, or -1 if not yet known
+  std::map<long, std::shared_ptr<const FunctionDisassembly>> disassembly_cache; // Disassembled functions by the start address of each part
+  std::map<std::string, SourceFile> source_cache; // Source files read into memory, by full path
+  std::string source_location; // Function and file of the frame last listed with "where", without MI
+  std::map<std::string, std::string> source_paths; // Full source paths by function and file, without MI
+  std::vector<Register> register_file; // Registers by GDB's register number
+  std::map<long, std::vector<Register>> thread_register_files; // Register files of the other threads, by thread
+  bool register_file_loaded; // Set once GDB was asked for the registers' names and groups
+  int register_panels_valid; // GG_PANEL_* flags of the register displays whose cached values are current
+  int unshown_changes; // GG_PANEL_* flags of the displays whose changes were read at a stop that was not shown
+  std::map<std::string, Variable> variables; // Variable objects of the locals and arguments and their listed children, by name
+  std::vector<std::string> root_variables; // Names of the variable objects of the locals and arguments, in order
+  std::vector<std::string> listed_expressions; // Variables of the frame as GDB last listed them
+  long variables_thread; // Thread selected when the variable objects were last updated
+  long variables_frame; // Frame selected when the variable objects were last updated
+  bool pretty_printing; // Set once GDB was asked to pretty print variable objects
+  ArrayInfo array; // Array shown in the array viewer
+  bool array_stale; // Set when the array must be located again, after a stop or a new expression
+  long array_generation; // Incremented whenever the array is located again
+  std::vector<long> array_pages; // Pages of the array last asked for, which are the ones on screen
+  std::vector<long> array_page_requests; // Pages asked for since the array viewer was last refreshed
+  std::map<std::string, std::string> resolved_types; // Types of array elements as ptype resolves them, by name
+  long list_size; // Cached listsize setting, restored after listing source code, or 0 if unknown
+  int changed_panels; // GG_PANEL_* flags set by MI stop and change notifications until the GUI takes them
+  GDBStats stats; // Latency statistics of every query
+  uint64_t poll_calls; // Total poll() calls made while waiting for output
+  uint64_t parse_time; // Total nanoseconds spent parsing MI records
+  std::function<bool()> interrupt_check; // Returns true once queries in progress are unwanted
   public:
   // Class constructor opens the process.
-  GDB(std::vector<std::string> args);
+  // If options.use_mi is set, GDB is started with the GDB/MI interpreter and
+  // user commands are forwarded to its console interpreter. If options.non_stop
+  // is set as well, GDB is also put in asynchronous, non-stop mode.
+  GDB(std::vector<std::string> args, GDBOptions options);
 
   // Class desctructor closes the process.
   ~GDB(void);
@@ -78,12 +809,14 @@ class GDB {
   void execute(const char * command);
 
   // Read whatever output and error is stored in the process.
-  // Method will try executing non-blocking reads until ... 
+  // Method will drain both pipes with non-blocking reads, then sleep in poll()
+  // until GDB writes again, until ... 
   //  a) the GDB process quits
   //  b) the prompt is detected at the end of the output buffer
+  //     (with MI, the prompt following the last command's result)
   void read_until_prompt(std::ostream & output_buffer, std::ostream & error_buffer, bool trim_prompt);
 
-  // Returns true if the GDB process is still alive.
+  // Returns true if the GDB process is still alive and its output can be read.
   bool is_alive();
 
   // Returns true if the GDB process is running/debugging a program.
@@ -101,8 +834,10 @@ class GDB {
   // Gets the value of a variable.
   std::string get_variable_value(const char * variable);
 
-  // Gets a heap-allocated StackFrame struct with information about the current stack frame. 
-  StackFrame * get_stack_frame();
+  // Gets a heap-allocated StackFrame struct with information about the current stack frame,
+  // which spans from the stack pointer to the canonical frame address. Returns
+  // nullptr with the reason in error if the frame's bounds cannot be found.
+  StackFrame * get_stack_frame(std::string & error);
 
   // Gets the assembly code for the function GDB is in.
   std::string get_assembly_code();
@@ -116,6 +851,86 @@ class GDB {
   // Gets the current line number GDB is positioned at.
   long get_source_line_number();
 
+  // Returns true if the inferior is big endian.
+  bool is_big_endian();
+
+  // Gets what the given GG_PANEL_* panels display about the current stop.
+  // With MI all of the queries are pipelined into a single round trip;
+  // the caller owns the returned stack frame. If the interrupt check fires
+  // between round trips, the rest are skipped and the info is marked cancelled.
+  StopInfo get_stop_info(int panels);
+
+  // Lists the next GG_VARIABLE_PAGE_SIZE children of a variable object, after
+  // the user expanded it. They are included with the variables from then on.
+  void list_variable_children(const std::string & name);
+
+  // Sets the expression shown in the array viewer, which is located at its next refresh.
+  void set_array_expression(const std::string & expression);
+
+  // Asks for pages of the array to be read at the next refresh of the array viewer.
+  void request_array_pages(const std::vector<long> & pages);
+
+  // Selects a thread at its innermost frame, as the thread command does. Returns false
+  // if the thread's innermost frame is already selected or GDB cannot select it.
+  bool select_thread(long thread);
+
+  // Gets GDB's number of the selected thread, or 0 if not known.
+  long get_selected_thread() {
+    return selected_thread;
+  }
+
+  // Gets the level of the selected frame.
+  long get_selected_frame() {
+    return selected_frame;
+  }
+
+  // Gets a number that changes whenever every thread may have run or the
+  // program's memory changed, but not when another thread or frame is selected.
+  long get_stop_generation() {
+    return all_threads_generation;
+  }
+
+  // Same as above, but also changes whenever the given thread ran on its own,
+  // which only happens in non-stop mode.
+  long get_stop_generation(long thread);
+
+  // Returns true if GDB runs in non-stop mode, where threads stop without a
+  // command and read_notifications() has to be called while GDB is idle.
+  bool is_non_stop() {
+    return mi && options.non_stop;
+  }
+
+  // Returns true if the given thread is running. Only ever the case in
+  // non-stop mode, since GDB is busy while the program runs otherwise.
+  bool is_thread_running(long thread);
+
+  // Handles the notifications GDB wrote since the last command without waiting
+  // for more, copying any output to the buffers. Returns true if they changed
+  // the state of the program, which take_state_change() then reports.
+  bool read_notifications(std::ostream & output_buffer, std::ostream & error_buffer);
+
+  // Sets the function that long queries poll between round trips to GDB,
+  // giving up once it returns true.
+  void set_interrupt_check(std::function<bool()> check) {
+    interrupt_check = check;
+  }
+
+  // Gets the latency statistics of the queries sent so far.
+  GDBStats & get_stats() {
+    return stats;
+  }
+
+  // Takes a snapshot of the work done talking to GDB so far.
+  IOCounters get_io_counters();
+
+  // Gets the GG_PANEL_* flags of the panels whose contents may have changed
+  // since the last call, updating the saved line number if the selected frame
+  // may have moved. With MI this follows GDB's stop and change notifications,
+  // so a thread other than the selected one only changes the thread list, unless
+  // the selected thread is running on its own and the stopped thread is selected
+  // instead; the command line interface only notices new lines, which change every panel.
+  int take_state_change();
+
   // Gets the last line number GDB was positioned at.
   long get_saved_line_number() {
     return saved_line_number;
@@ -126,6 +941,11 @@ class GDB {
     saved_line_number = line_number;
   }
   private:
+  // Returns true if the interrupt check says queries in progress are unwanted.
+  bool is_interrupted() {
+    return interrupt_check && interrupt_check();
+  }
+
   // Gives option to disable setting internal flags after an execution.
   void execute(const char * command, bool set_flags);
 
@@ -141,6 +961,261 @@ class GDB {
   // Examines the memory at the given location.
   std::string examine_and_read(const char * memory_location, 
       const char * memory_type, long num_addresses);
+
+  // Blocks until either of GDB's open pipes is readable or closed, or the poll times
+  // out. A pipe that hung up or failed with nothing left to read is marked closed.
+  void wait_for_output();
+
+  // Copies everything GDB wrote to its error pipe into the buffer.
+  void read_errors(std::ostream & error_buffer);
+
+  // Sends a raw MI command tagged with a fresh token, returning the token.
+  long execute_mi(const std::string & command);
+
+  // Sends a raw MI command and reads back its result record.
+  // Returns true if the command did not result in an error.
+  bool execute_mi_and_read(const std::string & command, MIRecord & result);
+
+  // Reads MI records until the result of the given token is seen, or the next
+  // prompt if the token is -1. Commands that resume the inferior are waited on
+  // until it stops again, just like the command line interface does.
+  void read_mi_until(long token, std::ostream & output_buffer, std::ostream & error_buffer, MIRecord * result);
+
+  // Updates cached state from an out-of-band MI record.
+  void handle_mi_async(const MIRecord & record);
+
+  // Records the thread and frame GDB selected, swapping in the thread's register file.
+  void set_selected_thread(long thread, long frame);
+
+  // Records threads resuming or stopping, given the thread-id or
+  // stopped-threads of an MI record: a thread, a list of them or "all".
+  void set_threads_running(const MIValue & threads, bool running);
+
+  // Lists the threads of the program in a round trip of their own.
+  std::vector<InferiorThread> list_threads();
+
+  // Evaluates an expression as a number through MI.
+  bool evaluate_long(const char * expression, long & value);
+
+  // Fills a stack frame's memory using MI, starting at its stack pointer.
+  void read_memory_mi(StackFrame * stack_frame);
+
+  // Writes every MI command to GDB before reading any reply, then matches
+  // the replies to the commands by token. The console and log output of
+  // each command is collected next to its result.
+  void execute_mi_batch(const std::vector<std::string> & commands, 
+      std::vector<MIRecord> & results, std::vector<std::string> & outputs);
+
+  // Same as above, but after each reply to the given commands the follow-up
+  // function may return more commands, which are sent at once. Their replies
+  // go to their own functions rather than to results and outputs.
+  void execute_mi_batch(const std::vector<std::string> & commands, 
+      std::vector<MIRecord> & results, std::vector<std::string> & outputs, MIFollowUp follow_up);
+
+  // Caches the position of the selected frame from an MI frame tuple.
+  void cache_frame_position(const MIValue & frame);
+
+  // Gets the position of the selected frame through MI, cached until the next user command.
+  bool get_frame_position(FramePosition & position);
+
+  // Gets the process ID of the inferior, or 0 if it is not known.
+  long get_inferior_pid();
+
+  // Reads the inferior's memory straight from the kernel, bypassing GDB.
+  // Returns false if the read is not permitted or only partially succeeds.
+  bool read_inferior_memory(long address, uint8_t * memory, long length);
+
+  // Fills a stack frame's memory with a direct read if possible.
+  bool read_stack_frame_directly(StackFrame * stack_frame);
+
+  // Fills in the canonical frame address of every frame listed by -stack-list-frames from
+  // the output of info frame applied to all of them, and gets the commands that ask for the
+  // frames it does not cover one at a time. Their replies fill in locations, which must
+  // outlive the batch.
+  std::vector<MIFollowUpCommand> locate_frames(const MIRecord & list, 
+      const std::string & output, FrameLocations & locations);
+
+  // Gets the bounds of the frames from their locations, keeping as many as GG_STACK_MAX_BYTES allows.
+  std::vector<FrameBounds> read_frame_bounds(const MIRecord & list, const FrameLocations & locations);
+
+  // Gets the address of the instruction GDB is stopped at, and without MI the name of the
+  // function containing it (left empty if GDB knows no symbol there).
+  bool get_program_counter(long & program_counter, std::string & function);
+
+  // Loads the names and groups of the inferior's registers, once per program.
+  // Returns false if GDB cannot list them.
+  bool load_register_file();
+
+  // Gets the numbers of the registers in a group.
+  std::vector<long> get_register_numbers(const char * group);
+
+  // Updates the register file from the reply to a raw value command,
+  // flagging the registers whose value changed.
+  void update_register_values(const MIRecord & raw);
+
+  // Gets the registers of a group in GDB's reply to -data-list-changed-registers.
+  std::vector<long> get_changed_registers(const MIRecord & result, const char * group);
+
+  // Updates the registers of the register file that "info registers" lists
+  // from its output, noting the lines of the ones that changed.
+  void read_registers(const std::string & output, std::vector<long> & changed_lines);
+
+  // Updates the register file from the reply to the value command of vector
+  // registers if there is one, and splits the vector registers into bytes.
+  std::vector<VectorRegister> read_vector_registers(const MIRecord * raw);
+
+  // Gets the commands that create variable objects for the frame's variables
+  // that have none and delete the ones of variables that went out of scope,
+  // given GDB's list of the frame's variables. Variables are added as GDB
+  // answers their creation.
+  std::vector<MIFollowUpCommand> sync_variables(const MIRecord & list);
+
+  // Applies the reply to the update of the variable objects, then gets every
+  // variable in display order.
+  std::vector<Variable> read_variables(const MIRecord & update);
+
+  // Forgets a variable object and its children; GDB deletes them on its own.
+  void forget_variable(const std::string & name);
+
+  // Asks GDB for the address, element type and length of the array in one round trip.
+  void locate_array();
+
+  // Gets the type of an expression as ptype resolves it, e.g. "unsigned int" for
+  // a uint32_t, caching it by the type's name. Structures give their first line.
+  std::string resolve_type(const std::string & name, const std::string & expression);
+
+  // Locates the array again if it is stale, then reads the pages asked for,
+  // straight from the inferior if possible and otherwise in one round trip.
+  ArrayView read_array();
+
+  // Gets the cached disassembly of the function containing the address, or nullptr.
+  const FunctionDisassembly * find_disassembly(long address);
+
+  // Caches the output of the disassemble command and slices it around the
+  // program counter. Output that is not a disassembly is returned as is.
+  std::string cache_disassembly(const std::string & assembly_dump, long program_counter);
+
+  // Gets the full path of the source file GDB is positioned in, or an empty string.
+  std::string get_source_path();
+
+  // Gets the source file at the given path, reading it again if it changed
+  // on disk. Returns nullptr if the file cannot be read.
+  SourceFile * find_source_file(const std::string & path);
+
+  // Drops cached state that depends on the program's code, after the program
+  // is replaced, restarted, or loads or unloads a shared library.
+  void invalidate_code_caches();
+};
+
+// Tracks which panels are on screen and which are older than the last stop,
+// so that only visible panels are queried when GDB stops and hidden ones are
+// fetched when their tab is selected. Shared by the GUI thread and the worker.
+class PanelTracker {
+  std::mutex mutex; // Guards everything below
+  int visible; // GG_PANEL_* flags of the panels on screen
+  int dirty; // Panels whose contents are older than the last stop
+  std::function<void()> on_dirty_shown; // Called when a dirty panel comes on screen
+  int running_callbacks; // Calls of on_dirty_shown under way, made without the lock
+  std::condition_variable callbacks_done; // Signalled whenever a call of on_dirty_shown returns
+  std::vector<std::string> variable_requests; // Variable objects whose next children the user asked for
+  std::string array_expression; // Expression entered in the array viewer, until taken
+  bool array_expression_set; // Set when there is an expression to take
+  std::vector<long> array_page_requests; // Pages of the array the viewer scrolled to
+  long thread_request; // Thread the user activated, until taken, or 0
+  public:
+  PanelTracker() : visible(GG_PANEL_SOURCE), dirty(0), running_callbacks(0),
+    array_expression_set(false), thread_request(0) {}
+
+  // Sets the panels on screen, calling back if any of them are dirty.
+  void set_visible(int panels);
+
+  // Sets the function called when a dirty panel comes on screen, waiting for
+  // calls of the previous one to return, so that it can be safely destroyed.
+  void set_on_dirty_shown(std::function<void()> callback);
+
+  // Marks panels dirty after GDB stops somewhere new or another thread or frame is selected.
+  void mark_dirty(int panels);
+
+  // Takes the dirty panels that are on screen, which are the ones to query,
+  // marking them clean in the same step so that panels dirtied while they are
+  // queried stay dirty. Panels whose refresh is abandoned are marked dirty again.
+  int take_panels_to_refresh();
+
+  // Asks for the next page of a variable's children, which refreshes the source panel.
+  void request_variable_children(const std::string & name);
+
+  // Takes the variables whose children were asked for since the last call.
+  std::vector<std::string> take_variable_requests();
+
+  // Shows a new expression in the array viewer, which refreshes it.
+  void request_array(const std::string & expression);
+
+  // Asks for a page of the array that scrolled into view, which refreshes the array viewer.
+  void request_array_page(long page);
+
+  // Takes the expression entered in the array viewer since the last call.
+  // Returns false if there is none.
+  bool take_array_expression(std::string & expression);
+
+  // Takes the pages of the array asked for since the last call.
+  std::vector<long> take_array_page_requests();
+
+  // Asks for a thread to be selected, which refreshes the panels showing it.
+  void request_thread(long thread);
+
+  // Takes the thread the user activated since the last call.
+  // Returns false if there is none.
+  bool take_thread_request(long & thread);
+  private:
+  // Marks panels dirty, then calls back if any dirty panel is on screen, or
+  // always if forced. The callback is called without the lock held.
+  void mark_dirty_and_notify(int panels, bool force);
+};
+
+// Gets the panel tracker shared by the GUI and the console.
+PanelTracker & get_panel_tracker();
+
+// Runs every interaction with GDB on a thread of its own. User commands are
+// run ahead of GUI refreshes, so the console gets its prompt back as soon as
+// GDB answers, while the panels are refreshed in the background. In non-stop
+// mode the idle worker also checks GDB for threads that stopped on their own.
+class GDBWorker {
+  GDB & gdb;
+  std::function<void(GDB &)> refresh; // Queries GDB and updates the GUI after a stop
+  std::mutex mutex; // Guards everything below
+  std::condition_variable condition; // Signalled when there is work or the worker stops
+  std::deque<std::function<void()>> jobs; // Pending user commands, in order
+  bool refresh_pending; // Set when the GUI needs refreshing; repeated requests are merged
+  bool stopping; // Set when the worker should exit
+  std::atomic<bool> alive; // Cached GDB::is_alive(), readable from any thread
+  std::thread thread; // Started last, once the state above is initialized
+  public:
+  // Constructor starts the worker thread, which owns gdb from then on.
+  GDBWorker(GDB & gdb, std::function<void(GDB &)> refresh);
+
+  // Destructor finishes the job in progress and joins the thread.
+  ~GDBWorker();
+
+  GDBWorker(const GDBWorker &) = delete;
+  GDBWorker & operator=(const GDBWorker &) = delete;
+
+  // Runs a job on the worker ahead of any refresh and waits for it to finish.
+  void run(std::function<void()> job);
+
+  // Schedules a refresh of the GUI once no user commands are waiting.
+  // A refresh in progress is abandoned as soon as a user command arrives.
+  void request_refresh();
+
+  // Returns true if the GDB process is still alive.
+  bool is_alive() {
+    return alive;
+  }
+  private:
+  // Returns true if a user command is waiting or the worker is stopping.
+  bool has_pending_jobs();
+
+  // Runs jobs and refreshes until the worker is stopped.
+  void loop();
 };
 
 // GUI application.
@@ -150,66 +1225,314 @@ class GDBApp : public wxApp {
     virtual bool OnInit();
 };
 
+// Lines of a multiline display that update_text() replaced.
+typedef struct {
+  long first; // First line replaced
+  long end; // Line after the last one replaced, in the new text; equal to first if nothing was
+  bool shifted; // Set if the lines after the replaced ones moved
+} ReplacedLines;
+
+// Finds the lines that differ between the text shown and a new value. The characters
+// of shown from start to shown_end are to be replaced by those of value from start to
+// value_end. Works on wxString and std::string alike, so it can be checked without a display.
+template <class Text>
+ReplacedLines find_replaced_lines(const Text & shown, const Text & value,
+    size_t & start, size_t & shown_end, size_t & value_end) {
+  ReplacedLines replaced = { 0, 0, false };
+
+  // Skip the lines at the start that are the same in both texts
+  size_t length = std::min(shown.length(), value.length());
+  size_t prefix = 0;
+  start = 0;
+  while (prefix < length && shown[prefix] == value[prefix]) {
+    if (shown[prefix++] == '\n') {
+      start = prefix;
+      replaced.first++;
+    }
+  }
+
+  // Then the lines at the end, without overlapping the lines at the start
+  size_t suffix = 0;
+  while (suffix < length - start &&
+      shown[shown.length() - suffix - 1] == value[value.length() - suffix - 1]) {
+    suffix++;
+  }
+  shown_end = shown.length() - suffix;
+  while (shown_end < shown.length() && shown_end > start && shown[shown_end - 1] != '\n') {
+    shown_end++;
+  }
+  value_end = shown_end - shown.length() + value.length();
+
+  // The last line replaced may not end with a newline
+  long new_lines = std::count(value.begin() + start, value.begin() + value_end, '\n');
+  long old_lines = std::count(shown.begin() + start, shown.begin() + shown_end, '\n');
+  bool unterminated = value_end > start && value[value_end - 1] != '\n';
+  replaced.end = replaced.first + new_lines + (unterminated ? 1 : 0);
+  replaced.shifted = new_lines != old_lines;
+  return replaced;
+}
+
+// Changes the text of a multiline display by replacing only the lines that
+// differ from the ones shown, and not at all if nothing changed. Unlike
+// SetValue(), this keeps the scroll position and does not relayout the whole text.
+ReplacedLines update_text(wxTextCtrl * text, const wxString & value);
+
+// Data of a row in the variables trees, naming the variable object it shows.
+class GDBVariableData : public wxTreeItemData {
+  public:
+  std::string name;
+  bool more; // Set for the row under a variable that lists more of its children
+
+  GDBVariableData(const std::string & name, bool more) : name(name), more(more) {}
+};
+
+// Rows of a variable in one of the variables trees.
+typedef struct {
+  wxTreeCtrl * tree;
+  wxTreeItemId item;
+  wxTreeItemId more; // Last child row, which lists more children when expanded or activated
+} VariableRow;
+
 // GUI display for source code, local variables, formal parameters.
 class GDBSourcePanel : public wxPanel {
   wxTextCtrl * sourceCodeText; // Displays source code 
-  wxTextCtrl * localsText; // Displays local variables
-  wxTextCtrl * paramsText; // Displays formal parameters
+  wxTreeCtrl * localsTree; // Displays local variables
+  wxTreeCtrl * paramsTree; // Displays formal parameters
+  std::map<std::string, VariableRow> variableRows; // Rows of the variables shown, by variable object
   public:
   // Constructor for the panel.
   GDBSourcePanel(wxWindow * parent);
 
   // Sets the text of the source code display.
   void SetSourceCode(wxString value) {
-    sourceCodeText->SetValue(value);
+    update_text(sourceCodeText, value);
   }
 
-  // Sets the text of the local variables display.
-  void SetLocalVariables(wxString value) {
-    localsText->SetValue(value);
-  }
+  // Updates the variables trees in place, keeping the rows the user expanded.
+  void SetVariables(const std::vector<Variable> & variables);
+  private:
+  // Called when the user expands a variable; lists its children if there are none yet.
+  void OnItemExpanding(wxTreeEvent & event);
 
-  // Sets the text of the formal parameters display.
-  void SetFormalParameters(wxString value) {
-    paramsText->SetValue(value);
-  }
+  // Called when the user activates a row; the row under a variable's children lists more.
+  void OnItemActivated(wxTreeEvent & event);
+
+  // Macro to specify that this panel has events that need binding
+  wxDECLARE_EVENT_TABLE();
 }; 
 
 // GUI display for assembly code & registers
 class GDBAssemblyPanel : public wxPanel {
   wxTextCtrl * assemblyCodeText; // Displays assembly code
   wxTextCtrl * registersText; // Displays register values
+  wxCollapsiblePane * vectorPane; // Holds the vector registers, which are only fetched when expanded
+  wxChoice * laneFormatChoice; // Selects how the lanes of vector registers are shown
+  wxTextCtrl * vectorText; // Displays vector register lanes
+  std::shared_ptr<const std::vector<VectorRegister>> vectorRegisters; // Vector registers shown
+  std::vector<long> registersHighlights; // Lines highlighted in the registers display
+  std::vector<long> vectorHighlights; // Lines highlighted in the vector registers display
   public:
   // Constructor for the panel.
   GDBAssemblyPanel(wxWindow * parent);
 
   // Sets the text of the assembly code display.
   void SetAssemblyCode(wxString value) {
-    assemblyCodeText->SetValue(value);
+    update_text(assemblyCodeText, value);
   }
 
-  // Sets the text of the registers display.
-  void SetRegisters(wxString value) {
-    registersText->SetValue(value);
+  // Sets the text of the registers display, highlighting the given lines, in ascending order.
+  void SetRegisters(wxString value, const std::vector<long> & changed_lines);
+
+  // Sets the vector registers, shown in the selected lane format.
+  void SetVectorRegisters(std::shared_ptr<const std::vector<VectorRegister>> registers);
+
+  // Returns true if the vector registers are expanded.
+  bool IsVectorShown() {
+    return vectorPane->IsExpanded();
   }
+  private:
+  // Formats the vector registers in the selected lane format.
+  void ShowVectorRegisters();
+
+  // Called when the user picks a different lane format.
+  void OnLaneFormat(wxCommandEvent & event) {
+    ShowVectorRegisters();
+  }
+
+  // Called when the user expands or collapses the vector registers.
+  void OnPaneChanged(wxCollapsiblePaneEvent & event);
+
+  // Macro to specify that this panel has events that need binding
+  wxDECLARE_EVENT_TABLE();
+};
+
+// Grid table backed directly by the accumulated stack bytes.
+// wxGrid only asks for the cells it draws, so values are formatted lazily.
+class GDBStackTable : public wxGridTableBase {
+  std::vector<uint8_t> stack_global; // Every stack byte seen so far, starting at stack_top
+  long stack_top;
+  long stack_pointer; // Stack pointer of the last frame shown
+  long frame_address; // Canonical frame address of the last frame shown
+  bool big_endian; // Byte order of the last frame shown
+  int word_size; // Number of bytes shown in each cell
+  wxGridCellAttr * garbageAttr; // Greys out memory above the stack pointer
+  wxGridCellAttr * stackPointerAttr; // Highlights the stack pointer's row
+  wxGridCellAttr * frameAddressAttr; // Highlights the canonical frame address's row
+  wxGridCellAttr * oddFrameAttr; // Shades the frames of odd levels, to tell the frames of the whole stack apart
+  std::shared_ptr<const std::vector<FrameBounds>> frames; // Frames of the whole stack, innermost first, or nullptr
+  public:
+  // Constructor for the table.
+  GDBStackTable();
+
+  // Destructor releases the shared cell attributes.
+  ~GDBStackTable();
+
+  // Merges a stack frame into the accumulated stack, or clears it if null.
+  void MergeStackFrame(const StackFrame * stack_frame);
+
+  // Sets the number of bytes shown in each cell.
+  void SetWordSize(int size);
+
+  // Sets the frames whose rows are labelled and shaded, or nullptr for none.
+  void SetFrameBounds(std::shared_ptr<const std::vector<FrameBounds>> bounds);
+
+  virtual int GetNumberRows();
+  virtual int GetNumberCols();
+  virtual wxString GetValue(int row, int col);
+  virtual wxString GetRowLabelValue(int row);
+  virtual wxString GetColLabelValue(int col);
+  virtual wxGridCellAttr * GetAttr(int row, int col, wxGridCellAttr::wxAttrKind kind);
+
+  // The stack is read-only.
+  virtual void SetValue(int row, int col, const wxString & value) {}
+  private:
+  // Gets the number of bytes covered by a row.
+  long GetRowSize() {
+    return GG_STACK_GRID_WORDS * word_size;
+  }
+
+  // Tells the grid how many rows were added or removed since it last looked.
+  void NotifyRowsChanged(int old_rows);
+
+  // Gets the frame of the whole stack holding the address, or nullptr.
+  const FrameBounds * FindFrame(long address);
 };
 
 // GUI display for stack frame
 class GDBStackPanel : public wxPanel {
   wxGrid * grid;
-  long * stack_global;
-  long stack_size;
-  long stack_top;
+  GDBStackTable * table; // Owned by the grid
+  wxChoice * wordSizeChoice; // Selects how many bytes each cell shows
+  wxCheckBox * wholeStackCheck; // Selects reading every frame of the thread rather than the current one
+  wxStaticText * errorText; // Why there is no frame to show, hidden when there is one
+  std::shared_ptr<const std::vector<FrameBounds>> frameBounds; // Frames of the whole stack last received
   public:
   // Constructor for the panel.
   GDBStackPanel(wxWindow * parent);
 
-  // Deconstructor for the panel.
-  ~GDBStackPanel();
+  // Merges a stack frame into the grid, or clears the grid if null.
+  void SetStackFrame(const StackFrame * stack_frame);
 
-  // Sets the grid of the stack frame.
-  // Note that the stack_frame data is deleted after this function call.
-  void SetStackFrame(StackFrame * stack_frame);
+  // Shows why there is no frame, or hides the message if empty.
+  void SetStackError(const wxString & error);
+
+  // Sets the frames of the whole stack, which are annotated while it is selected.
+  void SetFrameBounds(std::shared_ptr<const std::vector<FrameBounds>> bounds);
+
+  // Returns true if the whole stack is selected.
+  bool IsWholeStackShown() {
+    return wholeStackCheck->GetValue();
+  }
+  private:
+  // Called when the user picks a different word size.
+  void OnWordSize(wxCommandEvent & event);
+
+  // Called when the user selects or deselects the whole stack.
+  void OnWholeStack(wxCommandEvent & event);
+
+  // Macro to specify that this panel has events that need binding
+  wxDECLARE_EVENT_TABLE();
+};
+
+// Grid table over the pages of an array received so far, one element per row.
+// Rows whose page is missing ask the console for it when the grid draws them.
+class GDBArrayTable : public wxGridTableBase {
+  ArrayInfo info; // Array shown, with no elements until one is entered
+  long generation; // Generation of the pages held
+  bool big_endian; // Byte order of the elements
+  std::map<long, std::vector<uint8_t>> pages; // Pages received, by number
+  std::list<long> recent; // Numbers of the pages held, the most recently shown first
+  std::set<long> requested; // Pages asked for that have not arrived yet
+  public:
+  // Constructor for the table.
+  GDBArrayTable();
+
+  // Merges the pages read by a refresh, dropping the ones it made out of date.
+  void MergeArrayView(const ArrayView & view);
+
+  // Gets the array shown.
+  const ArrayInfo & GetArrayInfo() {
+    return info;
+  }
+
+  virtual int GetNumberRows();
+  virtual int GetNumberCols();
+  virtual wxString GetValue(int row, int col);
+  virtual wxString GetRowLabelValue(int row);
+  virtual wxString GetColLabelValue(int col);
+
+  // The array is read-only.
+  virtual void SetValue(int row, int col, const wxString & value) {}
+  private:
+  // Gets a page that was received, marking it as the most recently shown.
+  // Asks for it and returns nullptr if it has not been received.
+  const std::vector<uint8_t> * FindPage(long page);
+
+  // Tells the grid how many rows were added or removed since it last looked.
+  void NotifyRowsChanged(int old_rows);
+};
+
+// GUI display for an array entered by the user, read a page at a time as it scrolls.
+class GDBArrayPanel : public wxPanel {
+  wxTextCtrl * expressionText; // Expression of the array, shown when enter is pressed
+  wxStaticText * descriptionText; // Element type and length of the array, or why it cannot be shown
+  wxGrid * grid;
+  GDBArrayTable * table; // Owned by the grid
+  public:
+  // Constructor for the panel.
+  GDBArrayPanel(wxWindow * parent);
+
+  // Merges the pages read by a refresh into the grid.
+  void SetArrayView(const ArrayView & view);
+  private:
+  // Called when the user presses enter in the expression box.
+  void OnExpressionEntered(wxCommandEvent & event);
+
+  // Macro to specify that this panel has events that need binding
+  wxDECLARE_EVENT_TABLE();
+};
+
+// GUI display for the threads of the program. Activating a thread selects it,
+// and the other panels follow.
+class GDBThreadsPanel : public wxPanel {
+  wxStaticText * emptyText; // Shown when there are no threads
+  wxListCtrl * list; // One row per thread in GDB's order, holding the thread's number as item data
+  long selected; // GDB's number of the thread the other panels show
+  public:
+  // Constructor for the panel.
+  GDBThreadsPanel(wxWindow * parent);
+
+  // Lists the threads.
+  void SetThreads(const std::vector<InferiorThread> & threads);
+
+  // Marks the thread the other panels show.
+  void SetSelectedThread(long thread);
+  private:
+  // Called when the user double clicks a thread or presses enter on it.
+  void OnItemActivated(wxListEvent & event);
+
+  // Macro to specify that this panel has events that need binding
+  wxDECLARE_EVENT_TABLE();
 };
 
 // GUI top level display frame.
@@ -219,6 +1542,10 @@ class GDBFrame : public wxFrame {
   GDBSourcePanel * sourcePanel;
   GDBAssemblyPanel * assemblyPanel;
   GDBStackPanel * stackPanel;
+  GDBArrayPanel * arrayPanel;
+  GDBThreadsPanel * threadsPanel;
+  wxNotebook * tabs; // Holds the panels above, one per tab
+  DebugSnapshotPtr shown; // Snapshot on screen, or nullptr before the first one
   public:
   // Called by GDBApp::OnInit() when it is initializing the top level frame.
   GDBFrame(const wxString & title, 
@@ -233,40 +1560,22 @@ class GDBFrame : public wxFrame {
     Close(true);
   }
 
-  // Status bar should be updated.
-  void DoStatusBarUpdate(wxCommandEvent & event) {
-    SetStatusText(event.GetString());
-  }
-
-  // Source code display should be updated.
-  void DoSourceCodeUpdate(wxCommandEvent & event) {
-    sourcePanel->SetSourceCode(event.GetString());
-  }
-
-  // Local variable display should be updated.
-  void DoLocalsUpdate(wxCommandEvent & event) {
-    sourcePanel->SetLocalVariables(event.GetString());
-  }
+  // Called when the user switches tabs; tells the console which panel is shown.
+  void OnPageChanged(wxBookCtrlEvent & event);
 
-  // Formal parameter display should be updated.
-  void DoParamsUpdate(wxCommandEvent & event) {
-    sourcePanel->SetFormalParameters(event.GetString());
-  }
+  // Called when the user expands or collapses the vector registers.
+  void OnPaneChanged(wxCollapsiblePaneEvent & event);
 
-  // Assembly code display should be updated.
-  void DoAssemblyCodeUpdate(wxCommandEvent & event) {
-    assemblyPanel->SetAssemblyCode(event.GetString());
+  // Called when the user selects or deselects the whole stack.
+  void OnWholeStack(wxCommandEvent & event) {
+    UpdateVisiblePanels();
   }
 
-  // Registers display should be updated.
-  void DoRegistersUpdate(wxCommandEvent & event) {
-    assemblyPanel->SetRegisters(event.GetString());
-  }
+  // Tells the console which GG_PANEL_* panels are on screen.
+  void UpdateVisiblePanels();
 
-  void DoStackFrameUpdate(wxCommandEvent & event) {
-    StackFrame * stack_frame = (StackFrame *) event.GetClientData();
-    stackPanel->SetStackFrame(stack_frame);
-  }
+  // Displays the sections of a snapshot that differ from the one on screen.
+  void DoSnapshotUpdate(wxThreadEvent & event);
 
   // Macro to specify that this frame has events that need binding
   wxDECLARE_EVENT_TABLE();
@@ -2,6 +2,13 @@
 #include <wx/gbsizer.h>
 #include <wx/grid.h>
 #include <wx/dataview.h>
+#include <wx/choice.h>
+#include <wx/stattext.h>
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstring>
+#include <set>
 #include <sstream>
 
 #include "gg.hpp" 
@@ -15,6 +22,38 @@ std::string long_to_string(long value, int use_hex) {
   return conversion.str();
 }
 
+ReplacedLines update_text(wxTextCtrl * text, const wxString & value) {
+  wxString shown = text->GetValue();
+  if (shown == value) {
+    return { 0, 0, false };
+  }
+
+  size_t start, shown_end, value_end;
+  ReplacedLines replaced = find_replaced_lines(shown, value, start, shown_end, value_end);
+
+  // Replace the lines in between without redrawing until done
+  text->Freeze();
+  text->Replace(start, shown_end, value.Mid(start, value_end - start));
+  text->Thaw();
+  return replaced;
+}
+
+// Lane format of the vector registers display.
+typedef struct {
+  const char * name;
+  int size; // Bytes in each lane
+  char kind; // 'i' for signed, 'u' for unsigned, 'f' for floating point or 'x' for hexadecimal
+} LaneFormat;
+
+// Lane formats, in the order they are offered.
+static const LaneFormat lane_formats[] = {
+  { "i8", 1, 'i' }, { "i16", 2, 'i' }, { "i32", 4, 'i' }, { "i64", 8, 'i' },
+  { "u8", 1, 'u' }, { "u16", 2, 'u' }, { "u32", 4, 'u' }, { "u64", 8, 'u' },
+  { "f32", 4, 'f' }, { "f64", 8, 'f' },
+  { "x8", 1, 'x' }, { "x16", 2, 'x' }, { "x32", 4, 'x' }, { "x64", 8, 'x' }
+};
+#define LANE_FORMAT_DEFAULT 8 // f32
+
 bool GDBApp::OnInit() {
   // Determine screen and application dimensions
   long screen_x = wxSystemSettings::GetMetric(wxSYS_SCREEN_X);
@@ -47,7 +86,9 @@ GDBFrame::GDBFrame(const wxString & title,
     const wxString & clcommand, const wxString & clargs,
     const wxPoint & pos, const wxSize & size) :
   wxFrame(NULL, wxID_ANY, title, pos, size), 
-  command(clcommand), args(clargs)
+  command(clcommand), args(clargs),
+  sourcePanel(nullptr), assemblyPanel(nullptr), stackPanel(nullptr), arrayPanel(nullptr), 
+  threadsPanel(nullptr), tabs(nullptr)
 {
   // File section in the menu bar
   wxMenu * menuFile = new wxMenu();
@@ -68,7 +109,7 @@ GDBFrame::GDBFrame(const wxString & title,
   SetStatusText(GDB_STATUS_IDLE);
 
   // Create notebook (tabbed pane)
-  wxNotebook * tabs = new wxNotebook(this, wxID_ANY);
+  tabs = new wxNotebook(this, wxID_ANY);
 
   // Create source code display 
   sourcePanel = new GDBSourcePanel(tabs);
@@ -81,6 +122,105 @@ GDBFrame::GDBFrame(const wxString & title,
   // Create stack frame display
   stackPanel = new GDBStackPanel(tabs);
   tabs->AddPage(stackPanel, "Stack Frames");
+
+  // Create array display
+  arrayPanel = new GDBArrayPanel(tabs);
+  tabs->AddPage(arrayPanel, "Array");
+
+  // Create thread list display
+  threadsPanel = new GDBThreadsPanel(tabs);
+  tabs->AddPage(threadsPanel, "Threads");
+}
+
+void GDBFrame::OnPageChanged(wxBookCtrlEvent & event) {
+  UpdateVisiblePanels();
+  event.Skip();
+}
+
+void GDBFrame::OnPaneChanged(wxCollapsiblePaneEvent & event) {
+  UpdateVisiblePanels();
+}
+
+void GDBFrame::UpdateVisiblePanels() {
+  // Only the panels on screen are refreshed when GDB stops
+  wxWindow * page = tabs->GetCurrentPage();
+  int panels = GG_PANEL_SOURCE;
+  if (page == assemblyPanel) {
+    panels = GG_PANEL_ASSEMBLY | (assemblyPanel->IsVectorShown() ? GG_PANEL_VECTOR : 0);
+  }
+  else if (page == stackPanel) {
+    panels = GG_PANEL_STACK | (stackPanel->IsWholeStackShown() ? GG_PANEL_WHOLE_STACK : 0);
+  }
+  else if (page == arrayPanel) {
+    panels = GG_PANEL_ARRAY;
+  }
+  else if (page == threadsPanel) {
+    panels = GG_PANEL_THREADS;
+  }
+  get_panel_tracker().set_visible(panels);
+}
+
+// Helper function for telling if a snapshot's section needs displaying.
+template <class T>
+static bool section_changed(const std::shared_ptr<T> & section, const std::shared_ptr<T> & shown) {
+  return section && section != shown;
+}
+
+void GDBFrame::DoSnapshotUpdate(wxThreadEvent & event) {
+  DebugSnapshotPtr snapshot = event.GetPayload<DebugSnapshotPtr>();
+
+  // Sections shared with the snapshot on screen are already displayed
+  DebugSnapshot nothing_shown = DebugSnapshot();
+  const DebugSnapshot & old = shown ? *shown : nothing_shown;
+  if (section_changed(snapshot->status, old.status)) {
+    SetStatusText(*snapshot->status);
+  }
+  if (section_changed(snapshot->source_code, old.source_code)) {
+    sourcePanel->SetSourceCode(*snapshot->source_code);
+  }
+  if (section_changed(snapshot->variables, old.variables)) {
+    sourcePanel->SetVariables(*snapshot->variables);
+  }
+  if (section_changed(snapshot->assembly_code, old.assembly_code)) {
+    assemblyPanel->SetAssemblyCode(*snapshot->assembly_code);
+  }
+  if (section_changed(snapshot->registers, old.registers) ||
+      section_changed(snapshot->changed_registers, old.changed_registers)) {
+    assemblyPanel->SetRegisters(*snapshot->registers, *snapshot->changed_registers);
+  }
+
+  if (section_changed(snapshot->vector_registers, old.vector_registers)) {
+    assemblyPanel->SetVectorRegisters(snapshot->vector_registers);
+  }
+
+  // A missing frame is shown too, by clearing the grid. Stacks of different
+  // threads are far apart, so they replace each other rather than merging
+  bool thread_changed = snapshot->thread != old.thread;
+  if (thread_changed || snapshot->stack_frame != old.stack_frame) {
+    if (thread_changed) {
+      stackPanel->SetStackFrame(nullptr);
+    }
+    stackPanel->SetStackFrame(snapshot->stack_frame.get());
+  }
+  if (section_changed(snapshot->stack_error, old.stack_error)) {
+    stackPanel->SetStackError(*snapshot->stack_error);
+  }
+  if (section_changed(snapshot->stack_frames, old.stack_frames)) {
+    stackPanel->SetFrameBounds(snapshot->stack_frames);
+  }
+
+  if (section_changed(snapshot->array, old.array)) {
+    arrayPanel->SetArrayView(*snapshot->array);
+  }
+
+  if (section_changed(snapshot->threads, old.threads)) {
+    threadsPanel->SetThreads(*snapshot->threads);
+  }
+  if (thread_changed) {
+    threadsPanel->SetSelectedThread(snapshot->thread);
+  }
+
+  shown = snapshot;
 }
 
 void GDBFrame::OnAbout(wxCommandEvent & event) {
@@ -122,19 +262,22 @@ GDBSourcePanel::GDBSourcePanel(wxWindow * parent) :
       wxGBPosition(0, 0), wxGBSpan(2, 1), 
       wxALL | wxEXPAND, 5);
 
+  // Style for the variables trees, whose hidden root holds the variables
+  long treeCtrlStyle = wxTR_DEFAULT_STYLE | wxTR_HIDE_ROOT | wxTR_LINES_AT_ROOT;
+
   // Create local variables display and add to sizer
-  localsText = new wxTextCtrl(this, wxID_ANY, 
-      wxT(GDB_NO_LOCALS),
-      wxDefaultPosition, wxDefaultSize, textCtrlStyle);
-  sizer->Add(localsText, 
+  localsTree = new wxTreeCtrl(this, wxID_ANY, 
+      wxDefaultPosition, wxDefaultSize, treeCtrlStyle);
+  localsTree->AddRoot("");
+  sizer->Add(localsTree, 
       wxGBPosition(0, 1), wxGBSpan(1, 1), 
       wxALL | wxEXPAND, 5);
 
   // Create formal parameters display and add to sizer
-  paramsText = new wxTextCtrl(this, wxID_ANY, 
-      wxT(GDB_NO_PARAMS),
-      wxDefaultPosition, wxDefaultSize, textCtrlStyle);
-  sizer->Add(paramsText, 
+  paramsTree = new wxTreeCtrl(this, wxID_ANY, 
+      wxDefaultPosition, wxDefaultSize, treeCtrlStyle);
+  paramsTree->AddRoot("");
+  sizer->Add(paramsTree, 
       wxGBPosition(1, 1), wxGBSpan(1, 1), 
       wxALL | wxEXPAND, 5);
 
@@ -145,6 +288,105 @@ GDBSourcePanel::GDBSourcePanel(wxWindow * parent) :
   }
 }
 
+// Helper function for labelling the row that lists more of a variable's children.
+static wxString more_children_label(const Variable & variable) {
+  long remaining = variable.child_count - (long) variable.children.size();
+  return remaining > 0 ? wxString::Format("... %ld more", remaining) : wxString("...");
+}
+
+void GDBSourcePanel::SetVariables(const std::vector<Variable> & variables) {
+  localsTree->Freeze();
+  paramsTree->Freeze();
+
+  // Rows of variables that are gone are deleted along with their children's.
+  // Children are named after their parent, so they follow it in the map
+  std::set<std::string> names;
+  for (const Variable & variable : variables) {
+    names.insert(variable.name);
+  }
+  std::string deleted;
+  for (std::map<std::string, VariableRow>::iterator row = variableRows.begin(); row != variableRows.end();) {
+    bool child_of_deleted = !deleted.empty() && !row->first.compare(0, deleted.size() + 1, deleted + ".");
+    if (!child_of_deleted && names.count(row->first)) {
+      row++;
+      continue;
+    }
+    if (!child_of_deleted) {
+      row->second.tree->Delete(row->second.item);
+      deleted = row->first;
+    }
+    row = variableRows.erase(row);
+  }
+
+  // Parents come before their children, so a new row always has somewhere to go
+  wxColour highlighted(200, 0, 0);
+  for (const Variable & variable : variables) {
+    wxTreeCtrl * tree = variable.is_argument ? paramsTree : localsTree;
+    wxString label = variable.expression + " = " + variable.value;
+    std::map<std::string, VariableRow>::iterator row = variableRows.find(variable.name);
+    if (row == variableRows.end()) {
+      wxTreeItemId parent = tree->GetRootItem();
+      std::map<std::string, VariableRow>::iterator parent_row = variableRows.find(variable.parent);
+      if (parent_row != variableRows.end()) {
+        // The row listing more children goes back at the end below
+        parent = parent_row->second.item;
+        if (parent_row->second.more.IsOk()) {
+          tree->Delete(parent_row->second.more);
+          parent_row->second.more = wxTreeItemId();
+        }
+      }
+
+      VariableRow new_row = { tree, tree->AppendItem(parent, label, -1, -1, 
+          new GDBVariableData(variable.name, false)), wxTreeItemId() };
+      row = variableRows.insert(std::make_pair(variable.name, new_row)).first;
+    }
+    else if (tree->GetItemText(row->second.item) != label) {
+      tree->SetItemText(row->second.item, label);
+    }
+    tree->SetItemTextColour(row->second.item, variable.changed ? highlighted : tree->GetForegroundColour());
+  }
+
+  // Children that were not listed yet are stood in for by a row that lists
+  // them, which also lets variables with no listed children be expanded
+  for (const Variable & variable : variables) {
+    VariableRow & row = variableRows[variable.name];
+    bool more = variable.has_more || (long) variable.children.size() < variable.child_count;
+    if (!more && row.more.IsOk()) {
+      row.tree->Delete(row.more);
+      row.more = wxTreeItemId();
+    }
+    else if (more && !row.more.IsOk()) {
+      row.more = row.tree->AppendItem(row.item, more_children_label(variable), -1, -1,
+          new GDBVariableData(variable.name, true));
+    }
+    else if (more) {
+      row.tree->SetItemText(row.more, more_children_label(variable));
+    }
+  }
+
+  localsTree->Thaw();
+  paramsTree->Thaw();
+}
+
+void GDBSourcePanel::OnItemExpanding(wxTreeEvent & event) {
+  // A variable whose only row below it is the one listing more has no children listed yet
+  wxTreeCtrl * tree = (wxTreeCtrl *) event.GetEventObject();
+  wxTreeItemIdValue cookie;
+  wxTreeItemId child = tree->GetFirstChild(event.GetItem(), cookie);
+  GDBVariableData * data = child.IsOk() ? (GDBVariableData *) tree->GetItemData(child) : nullptr;
+  if (data && data->more && tree->GetChildrenCount(event.GetItem(), false) == 1) {
+    get_panel_tracker().request_variable_children(data->name);
+  }
+}
+
+void GDBSourcePanel::OnItemActivated(wxTreeEvent & event) {
+  wxTreeCtrl * tree = (wxTreeCtrl *) event.GetEventObject();
+  GDBVariableData * data = (GDBVariableData *) tree->GetItemData(event.GetItem());
+  if (data && data->more) {
+    get_panel_tracker().request_variable_children(data->name);
+  }
+}
+
 GDBAssemblyPanel::GDBAssemblyPanel(wxWindow * parent) :
   wxPanel(parent, wxID_ANY) 
 {
@@ -165,7 +407,33 @@ GDBAssemblyPanel::GDBAssemblyPanel(wxWindow * parent) :
   registersText = new wxTextCtrl(this, wxID_ANY, 
       wxT(GDB_NO_REGISTERS),
       wxDefaultPosition, wxDefaultSize, textCtrlStyle);
-  sizer->Add(registersText, wxGBPosition(0, 1), wxGBSpan(2, 1), wxALL | wxEXPAND, 5);
+  wxBoxSizer * registersSizer = new wxBoxSizer(wxVERTICAL);
+  registersSizer->Add(registersText, 1, wxEXPAND | wxBOTTOM, 5);
+
+  // Create vector registers display below, collapsed so that they are not fetched
+  vectorPane = new wxCollapsiblePane(this, wxID_ANY, "Vector registers");
+  registersSizer->Add(vectorPane, 0, wxEXPAND);
+  sizer->Add(registersSizer, wxGBPosition(0, 1), wxGBSpan(2, 1), wxALL | wxEXPAND, 5);
+
+  // Create the lane format selector
+  wxWindow * pane = vectorPane->GetPane();
+  wxBoxSizer * paneSizer = new wxBoxSizer(wxVERTICAL);
+  pane->SetSizer(paneSizer);
+  wxBoxSizer * optionsSizer = new wxBoxSizer(wxHORIZONTAL);
+  laneFormatChoice = new wxChoice(pane, wxID_ANY);
+  for (const LaneFormat & format : lane_formats) {
+    laneFormatChoice->Append(format.name);
+  }
+  laneFormatChoice->SetSelection(LANE_FORMAT_DEFAULT);
+  optionsSizer->Add(new wxStaticText(pane, wxID_ANY, "Lanes: "), 0, wxALIGN_CENTER_VERTICAL);
+  optionsSizer->Add(laneFormatChoice, 0, wxALL, 0);
+  paneSizer->Add(optionsSizer, 0, wxBOTTOM, 5);
+
+  // Create the vector registers text under it
+  vectorText = new wxTextCtrl(pane, wxID_ANY, 
+      wxT(GDB_NO_VECTOR_REGISTERS),
+      wxDefaultPosition, wxDefaultSize, textCtrlStyle);
+  paneSizer->Add(vectorText, 1, wxEXPAND);
 
   // Specify sizer rows and columns that should be growable
   sizer->AddGrowableRow(0, 1);
@@ -174,21 +442,364 @@ GDBAssemblyPanel::GDBAssemblyPanel(wxWindow * parent) :
   sizer->AddGrowableCol(1, 1);
 }
 
-GDBStackPanel::GDBStackPanel(wxWindow * parent) : wxPanel(parent, wxID_ANY), stack_global(NULL), stack_size(0), stack_top(0) {
-  // A simple box sizer should suffice
-  wxBoxSizer * sizer = new wxBoxSizer(wxHORIZONTAL);
+// Helper function for highlighting lines of a text display, and only those, after
+// update_text(). Only the lines replaced and the ones whose highlighting changed are
+// restyled, unless the other lines moved. Both lists of lines are in ascending order.
+static void highlight_lines(wxTextCtrl * text, const ReplacedLines & replaced,
+    const std::vector<long> & lines, std::vector<long> & highlighted) {
+  wxTextAttr normal(text->GetForegroundColour());
+  wxTextAttr changed(wxColour(200, 0, 0));
+  auto style_line = [&](long line, const wxTextAttr & style) {
+    long start = text->XYToPosition(0, line);
+    if (start >= 0) {
+      text->SetStyle(start, start + text->GetLineLength(line), style);
+    }
+  };
+
+  if (replaced.shifted) {
+    text->SetStyle(0, text->GetLastPosition(), normal);
+    for (long line : lines) {
+      style_line(line, changed);
+    }
+    highlighted = lines;
+    return;
+  }
+
+  // Replaced lines may take the style of the text they replaced
+  for (long line = replaced.first; line < replaced.end; line++) {
+    style_line(line, std::binary_search(lines.begin(), lines.end(), line) ? changed : normal);
+  }
+
+  // Walk both lists together to find the other lines that were or are now highlighted
+  std::vector<long>::const_iterator was = highlighted.begin();
+  std::vector<long>::const_iterator is = lines.begin();
+  while (was != highlighted.end() || is != lines.end()) {
+    if (is == lines.end() || (was != highlighted.end() && *was < *is)) {
+      if (*was < replaced.first || *was >= replaced.end) {
+        style_line(*was, normal);
+      }
+      was++;
+    }
+    else if (was == highlighted.end() || *is < *was) {
+      if (*is < replaced.first || *is >= replaced.end) {
+        style_line(*is, changed);
+      }
+      is++;
+    }
+    else {
+      was++;
+      is++;
+    }
+  }
+  highlighted = lines;
+}
+
+void GDBAssemblyPanel::SetRegisters(wxString value, const std::vector<long> & changed_lines) {
+  // Registers that changed at this stop are highlighted
+  ReplacedLines replaced = update_text(registersText, value);
+  highlight_lines(registersText, replaced, changed_lines, registersHighlights);
+}
+
+void GDBAssemblyPanel::SetVectorRegisters(std::shared_ptr<const std::vector<VectorRegister>> registers) {
+  vectorRegisters = registers;
+  ShowVectorRegisters();
+}
+
+// Helper function for formatting one lane of a vector register.
+static std::string format_lane(const MemoryView & view, long offset, const LaneFormat & format) {
+  uint64_t bits = view.word(offset, format.size);
+  int unused_bits = 64 - 8 * format.size;
+  char text[32];
+  if (format.kind == 'i') {
+    // Shifting back down copies the sign bit of the lane
+    snprintf(text, sizeof(text), "%lld", (long long) ((int64_t) (bits << unused_bits) >> unused_bits));
+  }
+  else if (format.kind == 'u') {
+    snprintf(text, sizeof(text), "%llu", (unsigned long long) bits);
+  }
+  else if (format.kind == 'f' && format.size == 4) {
+    uint32_t lane = bits;
+    float value;
+    memcpy(&value, &lane, sizeof(value));
+    snprintf(text, sizeof(text), "%g", value);
+  }
+  else if (format.kind == 'f') {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    snprintf(text, sizeof(text), "%g", value);
+  }
+  else {
+    snprintf(text, sizeof(text), "0x%llx", (unsigned long long) bits);
+  }
+  return text;
+}
+
+void GDBAssemblyPanel::ShowVectorRegisters() {
+  if (!vectorRegisters || vectorRegisters->empty()) {
+    ReplacedLines replaced = update_text(vectorText, GDB_NO_VECTOR_REGISTERS);
+    highlight_lines(vectorText, replaced, std::vector<long>(), vectorHighlights);
+    return;
+  }
+
+  // Each register is shown as e.g. "xmm0    f32x4  {1, 0, 0, 0}"
+  const LaneFormat & format = lane_formats[laneFormatChoice->GetSelection()];
+  std::string text;
+  std::vector<long> changed_lines;
+  long line = 0;
+  for (const VectorRegister & reg : *vectorRegisters) {
+    long lanes = reg.bytes.size() / format.size;
+    if (!lanes) {
+      continue;
+    }
+
+    std::string shape = std::string(format.name) + "x" + std::to_string(lanes);
+    text.append(reg.name).append(std::string(std::max(1, 8 - (int) reg.name.size()), ' '));
+    text.append(shape).append(std::string(std::max(1, 7 - (int) shape.size()), ' ')).append("{");
+    MemoryView view(reg.bytes.data(), reg.bytes.size(), reg.big_endian);
+    for (long lane = 0; lane < lanes; lane++) {
+      text.append(lane ? ", " : "").append(format_lane(view, lane * format.size, format));
+    }
+    text.append("}\n");
+
+    if (reg.changed) {
+      changed_lines.push_back(line);
+    }
+    line++;
+  }
+
+  ReplacedLines replaced = update_text(vectorText, text);
+  highlight_lines(vectorText, replaced, changed_lines, vectorHighlights);
+}
+
+void GDBAssemblyPanel::OnPaneChanged(wxCollapsiblePaneEvent & event) {
+  // The vector registers share the space with the other registers only while expanded
+  vectorPane->GetContainingSizer()->GetItem(vectorPane)->SetProportion(IsVectorShown() ? 1 : 0);
+  Layout();
+
+  // The frame also needs to know, to have the registers fetched
+  event.Skip();
+}
+
+GDBStackTable::GDBStackTable() : 
+  stack_top(0), stack_pointer(0), frame_address(0), big_endian(false), word_size(1) 
+{
+  // Attributes are shared by every cell that uses them
+  garbageAttr = new wxGridCellAttr();
+  garbageAttr->SetBackgroundColour(wxColour(200, 200, 200));
+  stackPointerAttr = new wxGridCellAttr();
+  stackPointerAttr->SetBackgroundColour(wxColour(255, 255, 124));
+  frameAddressAttr = new wxGridCellAttr();
+  frameAddressAttr->SetBackgroundColour(wxColour(182, 149, 192));
+  oddFrameAttr = new wxGridCellAttr();
+  oddFrameAttr->SetBackgroundColour(wxColour(225, 235, 250));
+}
+
+GDBStackTable::~GDBStackTable() {
+  garbageAttr->DecRef();
+  stackPointerAttr->DecRef();
+  frameAddressAttr->DecRef();
+  oddFrameAttr->DecRef();
+}
+
+void GDBStackTable::MergeStackFrame(const StackFrame * stack_frame) {
+  int old_rows = GetNumberRows();
+
+  if (!stack_frame || !stack_frame->memory) {
+    // Clear the global stack if given an empty stack frame
+    stack_global.clear();
+    stack_top = 0;
+  }
+  else {
+    // Determine the border addresses of the full stack & of the stack frame
+    long stack_frame_top = stack_frame->stack_pointer; 
+    long stack_frame_bottom = stack_frame->stack_pointer + stack_frame->memory_length; 
+    long stack_bottom = stack_top + stack_global.size();
+
+    if (stack_global.empty()) {
+      // The stack frame is the entire stack
+      stack_top = stack_frame_top;
+      stack_global.assign(stack_frame->memory, stack_frame->memory + stack_frame->memory_length);
+    }
+    else {
+      // Determine the border addresses of the combined stack
+      long new_stack_top = std::min(stack_frame_top, stack_top);
+      long new_stack_bottom = std::max(stack_frame_bottom, stack_bottom);
+
+      // Grow the stack if the frame lies outside of it; unknown addresses are filled with 0's
+      if (new_stack_top != stack_top || new_stack_bottom != stack_bottom) {
+        std::vector<uint8_t> new_stack(new_stack_bottom - new_stack_top, 0);
+        memcpy(new_stack.data() + (stack_top - new_stack_top), stack_global.data(), stack_global.size());
+        stack_global.swap(new_stack);
+        stack_top = new_stack_top;
+      }
+
+      // The stack frame takes precedence, since it represents the most recently known values
+      memcpy(stack_global.data() + (stack_frame_top - stack_top), 
+          stack_frame->memory, stack_frame->memory_length);
+    }
+
+    stack_pointer = stack_frame->stack_pointer;
+    frame_address = stack_frame->frame_address;
+    big_endian = stack_frame->big_endian;
+  }
+
+  NotifyRowsChanged(old_rows);
+}
+
+void GDBStackTable::SetWordSize(int size) {
+  int old_rows = GetNumberRows();
+  word_size = size;
+  NotifyRowsChanged(old_rows);
+}
+
+void GDBStackTable::SetFrameBounds(std::shared_ptr<const std::vector<FrameBounds>> bounds) {
+  frames = bounds;
+
+  // Only labels and colours change
+  NotifyRowsChanged(GetNumberRows());
+}
+
+const FrameBounds * GDBStackTable::FindFrame(long address) {
+  if (!frames) {
+    return nullptr;
+  }
+
+  // Frames are innermost first, so their addresses ascend
+  std::vector<FrameBounds>::const_iterator after = std::upper_bound(frames->begin(), frames->end(), address,
+      [](long address, const FrameBounds & frame) { return address < frame.stack_pointer; });
+  if (after == frames->begin() || address >= (after - 1)->top) {
+    return nullptr;
+  }
+  return &*(after - 1);
+}
+
+void GDBStackTable::NotifyRowsChanged(int old_rows) {
+  wxGrid * view = GetView();
+  if (!view) {
+    return;
+  }
+
+  int rows = GetNumberRows();
+  if (rows > old_rows) {
+    wxGridTableMessage message(this, wxGRIDTABLE_NOTIFY_ROWS_APPENDED, rows - old_rows);
+    view->ProcessTableMessage(message);
+  }
+  else if (rows < old_rows) {
+    wxGridTableMessage message(this, wxGRIDTABLE_NOTIFY_ROWS_DELETED, rows, old_rows - rows);
+    view->ProcessTableMessage(message);
+  }
+
+  // Visible cells are formatted again on the next paint
+  view->ForceRefresh();
+}
+
+int GDBStackTable::GetNumberRows() {
+  // Each row has GG_STACK_GRID_WORDS columns of memory values
+  return (stack_global.size() + GetRowSize() - 1) / GetRowSize();
+}
+
+int GDBStackTable::GetNumberCols() {
+  return 1 + GG_STACK_GRID_WORDS;
+}
+
+wxString GDBStackTable::GetValue(int row, int col) {
+  long offset = row * GetRowSize();
+
+  // The first column is the row address
+  if (col == 0) {
+    return long_to_string(stack_top + offset, 1);
+  }
+
+  // Other cells are stack words in the inferior's byte order
+  offset += (col - 1) * word_size;
+  if (offset >= (long) stack_global.size()) {
+    return wxString();
+  }
+  MemoryView view(stack_global.data(), stack_global.size(), big_endian);
+  return long_to_string(view.word(offset, word_size), 1);
+}
+
+wxString GDBStackTable::GetRowLabelValue(int row) {
+  long address = stack_top + row * GetRowSize();
+
+  // Rows above the stack pointer shouldn't be accessed via the frame pointer
+  if (address < stack_pointer) {
+    return "n/a";
+  }
+
+  // Rows of the whole stack are labelled by frame, with the function on the frame's first row
+  const FrameBounds * frame = FindFrame(address);
+  if (frame) {
+    std::string label = "#" + std::to_string(frame->level);
+    if (address - GetRowSize() < frame->stack_pointer) {
+      label.append(" ").append(frame->function);
+    }
+    return label;
+  }
+  return long_to_string(address - frame_address, 0);
+}
+
+wxString GDBStackTable::GetColLabelValue(int col) {
+  if (col == 0) {
+    return "Address\t\t";
+  }
+  return "Address[" + std::to_string((col - 1) * word_size) + "]\t\t";
+}
+
+wxGridCellAttr * GDBStackTable::GetAttr(int row, int col, wxGridCellAttr::wxAttrKind kind) {
+  long address = stack_top + row * GetRowSize();
+  wxGridCellAttr * attr = nullptr;
+
+  // Highlight the stack pointer and the last row of the frame, below its canonical frame address
+  if (col == 0 && stack_pointer >= address && stack_pointer < address + GetRowSize()) {
+    attr = stackPointerAttr;
+  }
+  else if (col == 0 && frame_address > address && frame_address <= address + GetRowSize()) {
+    attr = frameAddressAttr;
+  }
+  // Grey out memory above the stack pointer; this is garbage space
+  else if (address < stack_pointer) {
+    attr = garbageAttr;
+  }
+  // Frames of the whole stack alternate in colour
+  else if (FindFrame(address) && FindFrame(address)->level % 2) {
+    attr = oddFrameAttr;
+  }
+
+  // The grid releases the reference it is given
+  if (attr) {
+    attr->IncRef();
+  }
+  return attr;
+}
+
+GDBStackPanel::GDBStackPanel(wxWindow * parent) : wxPanel(parent, wxID_ANY) {
+  // The grid fills the panel under a row of display options
+  wxBoxSizer * sizer = new wxBoxSizer(wxVERTICAL);
   SetSizer(sizer);
 
-  // Create the grid object and the five columns that go with it
-  grid = new wxGrid(this, wxID_ANY, wxDefaultPosition, wxDefaultSize);
-  grid->CreateGrid(0, 5);
+  // Create the word size selector
+  wxBoxSizer * optionsSizer = new wxBoxSizer(wxHORIZONTAL);
+  wxString wordSizes[] = { "1 byte", "2 bytes", "4 bytes", "8 bytes" };
+  wordSizeChoice = new wxChoice(this, wxID_ANY, wxDefaultPosition, wxDefaultSize, 4, wordSizes);
+  wordSizeChoice->SetSelection(0);
+  optionsSizer->Add(new wxStaticText(this, wxID_ANY, "Word size: "), 0, wxALIGN_CENTER_VERTICAL);
+  optionsSizer->Add(wordSizeChoice, 0, wxALL, 0);
+
+  // Create the whole stack selector
+  wholeStackCheck = new wxCheckBox(this, wxID_ANY, "Whole stack");
+  optionsSizer->Add(wholeStackCheck, 0, wxLEFT | wxALIGN_CENTER_VERTICAL, 10);
+  sizer->Add(optionsSizer, 0, wxLEFT | wxRIGHT | wxTOP, 5);
 
-  // Set the titles for each column
-  grid->SetColLabelValue(0, "Address\t\t");
-  grid->SetColLabelValue(1, "Address[0]\t\t");
-  grid->SetColLabelValue(2, "Address[1]\t\t");
-  grid->SetColLabelValue(3, "Address[2]\t\t");
-  grid->SetColLabelValue(4, "Address[3]\t\t");
+  // Create the message shown in place of a frame GDB could not locate
+  errorText = new wxStaticText(this, wxID_ANY, "");
+  errorText->Hide();
+  sizer->Add(errorText, 0, wxLEFT | wxRIGHT | wxTOP, 5);
+
+  // Create the grid object on top of the stack table, which supplies the five columns
+  grid = new wxGrid(this, wxID_ANY, wxDefaultPosition, wxDefaultSize);
+  table = new GDBStackTable();
+  grid->SetTable(table, true);
 
   // Disable editing & resize grid to fit labels
   grid->AutoSize();
@@ -198,139 +809,273 @@ GDBStackPanel::GDBStackPanel(wxWindow * parent) : wxPanel(parent, wxID_ANY), sta
   sizer->Add(grid, 1, wxEXPAND | wxALL, 5);
 }
 
-GDBStackPanel::~GDBStackPanel() {
-  // The destructor just needs to clean up the global stack if it exists.
-  if (stack_global) {
-    delete stack_global;
+void GDBStackPanel::SetStackFrame(const StackFrame * stack_frame) {
+  table->MergeStackFrame(stack_frame);
+}
+
+void GDBStackPanel::SetStackError(const wxString & error) {
+  errorText->SetLabel(error);
+  errorText->Show(!error.empty());
+  Layout();
+}
+
+void GDBStackPanel::SetFrameBounds(std::shared_ptr<const std::vector<FrameBounds>> bounds) {
+  frameBounds = bounds;
+  if (IsWholeStackShown()) {
+    table->SetFrameBounds(bounds);
   }
 }
 
-void GDBStackPanel::SetStackFrame(StackFrame * stack_frame) {
-  // Delete old rows from the grid
-  if (grid->GetNumberRows()) {
-    grid->DeleteRows(0, grid->GetNumberRows());
+void GDBStackPanel::OnWordSize(wxCommandEvent & event) {
+  // Choices are 1, 2, 4 and 8 bytes
+  table->SetWordSize(1 << wordSizeChoice->GetSelection());
+}
+
+void GDBStackPanel::OnWholeStack(wxCommandEvent & event) {
+  table->SetFrameBounds(IsWholeStackShown() ? frameBounds : nullptr);
+
+  // The frame also needs to know, to have the whole stack fetched
+  event.Skip();
+}
+
+GDBArrayTable::GDBArrayTable() : generation(-1), big_endian(false) {
+  info.address = 0;
+  info.element_size = 0;
+  info.length = 0;
+  info.element_kind = 0;
+  info.element_char = false;
+  info.error = GDB_ARRAY_HINT;
+}
+
+void GDBArrayTable::MergeArrayView(const ArrayView & view) {
+  int old_rows = GetNumberRows();
+
+  // Pages of another stop or another array are out of date
+  if (view.generation != generation) {
+    pages.clear();
+    recent.clear();
+    requested.clear();
+    generation = view.generation;
   }
+  info = view.info;
 
-  if (!stack_frame || !stack_frame->memory) {
-    // Clear the global stack if given an empty stack frame
-    if (stack_global) {
-      delete stack_global;
-      stack_global = nullptr;
-      stack_size = 0;
-      stack_top = 0;
+  for (const ArrayPage & page : view.pages) {
+    if (!pages.count(page.index)) {
+      recent.push_front(page.index);
     }
+    pages[page.index] = page.bytes;
+    requested.erase(page.index);
+    big_endian = view.big_endian;
   }
-  else {
-    if (stack_global) {
-      // Determine the border addresses of the full stack & of the stack frame
-      long stack_frame_top = stack_frame->stack_pointer; 
-      long stack_frame_bottom = stack_frame->stack_pointer + stack_frame->memory_length; 
-      long stack_bottom = stack_top + stack_size;
 
-      // Determine the border addresses of the combined stack
-      long new_stack_top = stack_frame_top < stack_top ? stack_frame_top : stack_top; 
-      long new_stack_bottom = stack_frame_bottom > stack_bottom ? stack_frame_bottom : stack_bottom;
-      long new_stack_size = new_stack_bottom - new_stack_top;
-
-      // Create the new, combined stack as a list of long values (representing bytes)
-      long * new_stack;
-      int free_old_stack;
-
-      // If the stack border addresses haven't changed, we can reuse the old stack array and avoid malloc'ing a new one
-      if (new_stack_top == stack_top && new_stack_bottom == stack_bottom) {
-        new_stack = stack_global;
-        free_old_stack = 0;
-      }
-      else {
-        new_stack = (long *) malloc(new_stack_size * sizeof(long));
-        free_old_stack = 1;
-      }
-      
-      // Copy the values of the stack frame and the old stack into the new stack
-      for (int index = 0; index < new_stack_size; index++) {
-        long address = new_stack_top + index;
-
-        // The stack frame takes precedence, since it represents the most recently known values
-        if (address >= stack_frame_top && address < stack_frame_bottom) {
-          new_stack[index] = stack_frame->memory[address - stack_frame_top];
-        }
-        // The old stack is then used to fill the new stack's values 
-        else if (address >= stack_top && address < stack_bottom) {
-          new_stack[index] = stack_global[address - stack_top];
-        }
-        // Any unknown addresses are filled with 0's
-        else {
-          new_stack[index] = 0;
-        }
-      }
+  // Pages that scrolled out of view long ago are read again if they come back
+  while (recent.size() > GG_ARRAY_CACHED_PAGES) {
+    pages.erase(recent.back());
+    recent.pop_back();
+  }
 
-      // If we created a new stack, we need to delete the old stack to prevent memory leaks
-      if (free_old_stack) {
-        delete stack_global;
-      }
+  NotifyRowsChanged(old_rows);
+}
 
-      // Replace the stack values
-      stack_global = new_stack;
-      stack_size = new_stack_size;
-      stack_top = new_stack_top;
+const std::vector<uint8_t> * GDBArrayTable::FindPage(long page) {
+  std::map<long, std::vector<uint8_t>>::iterator found = pages.find(page);
+  if (found == pages.end()) {
+    if (requested.insert(page).second) {
+      get_panel_tracker().request_array_page(page);
     }
-    else {
-      // Since the stack doesn't exist, we need to allocate memory for it
-      stack_global = (long *) malloc(stack_frame->memory_length * sizeof(long));
-      stack_size = stack_frame->memory_length;
-      stack_top = stack_frame->stack_pointer;
+    return nullptr;
+  }
 
-      // The stack frame is the entire stack, so we copy the frame's values into the global stack 
-      memcpy(stack_global, stack_frame->memory, stack_frame->memory_length * sizeof(long));
-    }
+  // Only a few pages are kept, so the list is short
+  recent.splice(recent.begin(), recent, std::find(recent.begin(), recent.end(), page));
+  return &found->second;
+}
 
-    // Each row has 4 columns of memory values
-    grid->AppendRows(stack_size / 4);
-
-    // Loop through each value on the stack
-    for (int index = 0; index < stack_size; index++) {
-      long value = stack_global[index];
-      long address = stack_top + index;
-      long row =  index / 4;
-      long col = index % 4;
-
-      // Set the row address & frame pointer offset
-      if (col == 0) {
-        grid->SetCellValue(row, 0, long_to_string(stack_top + index, 1)); 
-
-        // Switch row identification based on its location relative to the stack pointer
-        if (address < stack_frame->stack_pointer) {
-          // Rows above the stack pointer shouldn't be accessed via the frame pointer
-          grid->SetRowLabelValue(row, "n/a");
-
-          // Grey out memory above the stack pointer; this is garbage space
-          for (long col2 = 0; col2 < 5; col2++) {
-            grid->SetCellBackgroundColour(row, col2, wxColour(200, 200, 200));
-          }
-        }
-        else {
-          grid->SetRowLabelValue(row, long_to_string(address - stack_frame->frame_pointer, 0)); 
-        }
+void GDBArrayTable::NotifyRowsChanged(int old_rows) {
+  wxGrid * view = GetView();
+  if (!view) {
+    return;
+  }
 
-        // Highlight the stack pointer
-        if (address == stack_frame->stack_pointer) {
-          grid->SetCellBackgroundColour(row, 0, wxColour(255, 255, 124));
-        }
-        else if (address == stack_frame->frame_pointer) {
-          grid->SetCellBackgroundColour(row, 0, wxColour(182, 149, 192));
-        }
-      }
+  int rows = GetNumberRows();
+  if (rows > old_rows) {
+    wxGridTableMessage message(this, wxGRIDTABLE_NOTIFY_ROWS_APPENDED, rows - old_rows);
+    view->ProcessTableMessage(message);
+  }
+  else if (rows < old_rows) {
+    wxGridTableMessage message(this, wxGRIDTABLE_NOTIFY_ROWS_DELETED, rows, old_rows - rows);
+    view->ProcessTableMessage(message);
+  }
+
+  // Visible cells are formatted again on the next paint, which asks for missing pages
+  view->ForceRefresh();
+}
 
-      // Set the cell value to be the stack value
-      grid->SetCellValue(row, col + 1, long_to_string(value, 1));
+int GDBArrayTable::GetNumberRows() {
+  // The grid counts its rows in an int
+  return info.error.empty() ? std::min(info.length, (long) INT_MAX) : 0;
+}
+
+int GDBArrayTable::GetNumberCols() {
+  return 2;
+}
+
+// Helper function for formatting an element of an array according to how its type was classified.
+// Scalars are shown as numbers; anything else is shown as bytes.
+static std::string format_element(const MemoryView & view, long offset, const ArrayInfo & info) {
+  long size = info.element_size;
+  bool sized = info.element_kind == 'f' ? size == 4 || size == 8 : size == 1 || size == 2 || size == 4 || size == 8;
+  if (info.element_kind && sized) {
+    LaneFormat format = { "", (int) size, info.element_kind };
+    std::string text = format_lane(view, offset, format);
+
+    // Characters are shown as GDB shows them, e.g. 65 'A'
+    uint8_t byte = view.u8(offset);
+    if (size == 1 && info.element_char && isprint(byte)) {
+      text.append(" '").append(1, (char) byte).append("'");
     }
+    return text;
+  }
+
+  // Structures and other elements are shown as their first bytes in memory order
+  std::string text = "{";
+  char hex[8];
+  for (long i = 0; i < std::min(size, (long) 16); i++) {
+    snprintf(hex, sizeof(hex), i ? " %02x" : "%02x", view.u8(offset + i));
+    text.append(hex);
+  }
+  return text.append(size > 16 ? " ...}" : "}");
+}
+
+wxString GDBArrayTable::GetValue(int row, int col) {
+  // The first column is the address of the element
+  if (col == 0) {
+    return long_to_string(info.address + row * info.element_size, 1);
+  }
+
+  // Elements of pages that have not arrived yet are filled in when they do
+  const std::vector<uint8_t> * page = FindPage(row / GG_ARRAY_PAGE_ELEMENTS);
+  if (!page) {
+    return "...";
   }
+  MemoryView view(page->data(), page->size(), big_endian);
+  long offset = (row % GG_ARRAY_PAGE_ELEMENTS) * info.element_size;
+  return format_element(view, offset, info);
+}
+
+wxString GDBArrayTable::GetRowLabelValue(int row) {
+  return std::to_string(row);
+}
+
+wxString GDBArrayTable::GetColLabelValue(int col) {
+  if (col == 0) {
+    return "Address\t\t";
+  }
+  return info.element_type.empty() ? "Value\t\t" : info.element_type + "\t\t";
+}
 
-  // Delete the stack frame and any memory associated with it
-  if (stack_frame) {
-    if (stack_frame->memory) {
-      delete stack_frame->memory;
+GDBArrayPanel::GDBArrayPanel(wxWindow * parent) : wxPanel(parent, wxID_ANY) {
+  // The grid fills the panel under the expression and its description
+  wxBoxSizer * sizer = new wxBoxSizer(wxVERTICAL);
+  SetSizer(sizer);
+
+  // Create the expression box, which shows the array when enter is pressed
+  wxBoxSizer * expressionSizer = new wxBoxSizer(wxHORIZONTAL);
+  expressionText = new wxTextCtrl(this, wxID_ANY, "", 
+      wxDefaultPosition, wxDefaultSize, wxTE_PROCESS_ENTER);
+  expressionSizer->Add(new wxStaticText(this, wxID_ANY, "Array: "), 0, wxALIGN_CENTER_VERTICAL);
+  expressionSizer->Add(expressionText, 1, wxALL, 0);
+  sizer->Add(expressionSizer, 0, wxEXPAND | wxLEFT | wxRIGHT | wxTOP, 5);
+
+  descriptionText = new wxStaticText(this, wxID_ANY, GDB_ARRAY_HINT);
+  sizer->Add(descriptionText, 0, wxLEFT | wxRIGHT | wxTOP, 5);
+
+  // Create the grid object on top of the array table, which reads elements a page at a time
+  grid = new wxGrid(this, wxID_ANY, wxDefaultPosition, wxDefaultSize);
+  table = new GDBArrayTable();
+  grid->SetTable(table, true);
+
+  // Disable editing & resize grid to fit labels
+  grid->AutoSize();
+  grid->EnableEditing(false);
+
+  // Add the grid to the sizer
+  sizer->Add(grid, 1, wxEXPAND | wxALL, 5);
+}
+
+void GDBArrayPanel::SetArrayView(const ArrayView & view) {
+  table->MergeArrayView(view);
+
+  // e.g. "1048576 elements of char at 0x7ffd5c2e1a30"
+  const ArrayInfo & info = table->GetArrayInfo();
+  if (!info.error.empty()) {
+    descriptionText->SetLabel(info.error);
+  }
+  else {
+    std::string type = info.element_type.empty() ? 
+      std::to_string(info.element_size) + " bytes" : info.element_type;
+    descriptionText->SetLabel(std::to_string(info.length) + " elements of " + type + 
+        " at " + long_to_string(info.address, 1));
+  }
+}
+
+void GDBArrayPanel::OnExpressionEntered(wxCommandEvent & event) {
+  get_panel_tracker().request_array(expressionText->GetValue().ToStdString());
+}
+
+GDBThreadsPanel::GDBThreadsPanel(wxWindow * parent) : wxPanel(parent, wxID_ANY), selected(0) {
+  wxBoxSizer * sizer = new wxBoxSizer(wxVERTICAL);
+  SetSizer(sizer);
+
+  emptyText = new wxStaticText(this, wxID_ANY, GDB_NO_THREADS);
+  sizer->Add(emptyText, 0, wxLEFT | wxRIGHT | wxTOP, 5);
+
+  // Create the list, whose first column marks the selected thread like "info threads" does
+  list = new wxListCtrl(this, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxLC_REPORT | wxLC_SINGLE_SEL);
+  list->InsertColumn(0, "");
+  list->InsertColumn(1, "Id", wxLIST_FORMAT_RIGHT);
+  list->InsertColumn(2, "Target Id");
+  list->InsertColumn(3, "Name");
+  list->InsertColumn(4, "State");
+  list->InsertColumn(5, "Frame");
+  sizer->Add(list, 1, wxEXPAND | wxALL, 5);
+}
+
+void GDBThreadsPanel::SetThreads(const std::vector<InferiorThread> & threads) {
+  emptyText->Show(threads.empty());
+
+  // Threads come and go, so the list is rebuilt rather than merged
+  list->Freeze();
+  list->DeleteAllItems();
+  for (size_t i = 0; i < threads.size(); i++) {
+    const InferiorThread & thread = threads[i];
+    std::string frame = thread.function;
+    if (!thread.location.empty()) {
+      frame.append(" at ").append(thread.location);
     }
-    delete stack_frame;
+
+    long row = list->InsertItem(i, thread.id == selected ? "*" : "");
+    list->SetItemData(row, thread.id);
+    list->SetItem(row, 1, std::to_string(thread.id));
+    list->SetItem(row, 2, thread.target_id);
+    list->SetItem(row, 3, thread.name);
+    list->SetItem(row, 4, thread.state);
+    list->SetItem(row, 5, frame);
+  }
+  for (int column = 0; column < 6; column++) {
+    list->SetColumnWidth(column, wxLIST_AUTOSIZE_USEHEADER);
+  }
+  list->Thaw();
+  Layout();
+}
+
+void GDBThreadsPanel::SetSelectedThread(long thread) {
+  selected = thread;
+  for (int row = 0; row < list->GetItemCount(); row++) {
+    list->SetItem(row, 0, list->GetItemData(row) == selected ? "*" : "");
   }
 }
+
+void GDBThreadsPanel::OnItemActivated(wxListEvent & event) {
+  get_panel_tracker().request_thread(list->GetItemData(event.GetIndex()));
+}
@@ -1,4 +1,5 @@
 #include <thread>
+#include <fstream>
 
 #include <readline/readline.h>
 #include <readline/history.h>
@@ -10,21 +11,50 @@
 wxBEGIN_EVENT_TABLE(GDBFrame, wxFrame)
   EVT_MENU(wxID_EXIT, GDBFrame::OnExit)
   EVT_MENU(wxID_ABOUT, GDBFrame::OnAbout)
-  EVT_COMMAND(wxID_ANY, GDB_EVT_STATUS_BAR_UPDATE, GDBFrame::DoStatusBarUpdate)
-  EVT_COMMAND(wxID_ANY, GDB_EVT_SOURCE_CODE_UPDATE, GDBFrame::DoSourceCodeUpdate)
-  EVT_COMMAND(wxID_ANY, GDB_EVT_LOCALS_UPDATE, GDBFrame::DoLocalsUpdate)
-  EVT_COMMAND(wxID_ANY, GDB_EVT_PARAMS_UPDATE, GDBFrame::DoParamsUpdate)
-  EVT_COMMAND(wxID_ANY, GDB_EVT_ASSEMBLY_CODE_UPDATE, GDBFrame::DoAssemblyCodeUpdate)
-  EVT_COMMAND(wxID_ANY, GDB_EVT_REGISTERS_UPDATE, GDBFrame::DoRegistersUpdate)
-  EVT_COMMAND(wxID_ANY, GDB_EVT_STACK_FRAME_UPDATE, GDBFrame::DoStackFrameUpdate) 
+  EVT_NOTEBOOK_PAGE_CHANGED(wxID_ANY, GDBFrame::OnPageChanged)
+  EVT_COLLAPSIBLEPANE_CHANGED(wxID_ANY, GDBFrame::OnPaneChanged)
+  EVT_CHECKBOX(wxID_ANY, GDBFrame::OnWholeStack)
+  EVT_GDB_SNAPSHOT_UPDATE(wxID_ANY, GDBFrame::DoSnapshotUpdate)
+wxEND_EVENT_TABLE()
+
+wxBEGIN_EVENT_TABLE(GDBSourcePanel, wxPanel)
+  EVT_TREE_ITEM_EXPANDING(wxID_ANY, GDBSourcePanel::OnItemExpanding)
+  EVT_TREE_ITEM_ACTIVATED(wxID_ANY, GDBSourcePanel::OnItemActivated)
+wxEND_EVENT_TABLE()
+
+wxBEGIN_EVENT_TABLE(GDBAssemblyPanel, wxPanel)
+  EVT_CHOICE(wxID_ANY, GDBAssemblyPanel::OnLaneFormat)
+  EVT_COLLAPSIBLEPANE_CHANGED(wxID_ANY, GDBAssemblyPanel::OnPaneChanged)
+wxEND_EVENT_TABLE()
+
+wxBEGIN_EVENT_TABLE(GDBStackPanel, wxPanel)
+  EVT_CHOICE(wxID_ANY, GDBStackPanel::OnWordSize)
+  EVT_CHECKBOX(wxID_ANY, GDBStackPanel::OnWholeStack)
+wxEND_EVENT_TABLE()
+
+wxBEGIN_EVENT_TABLE(GDBArrayPanel, wxPanel)
+  EVT_TEXT_ENTER(wxID_ANY, GDBArrayPanel::OnExpressionEntered)
+wxEND_EVENT_TABLE()
+
+wxBEGIN_EVENT_TABLE(GDBThreadsPanel, wxPanel)
+  EVT_LIST_ITEM_ACTIVATED(wxID_ANY, GDBThreadsPanel::OnItemActivated)
 wxEND_EVENT_TABLE()
 
 // Macro to tell wxWidgets to use our GDB GUI application.
 wxIMPLEMENT_APP_NO_MAIN(GDBApp);
 
-void update_console_and_gui(GDB & gdb) {
+void update_console(GDB & gdb) {
   // Read from GDB to populate buffer
+  IOCounters command_start = gdb.get_io_counters();
   gdb.read_until_prompt(std::cout, std::cerr, true);
+  gdb.get_stats().record("command", command_start, gdb.get_io_counters());
+}
+
+void update_gui(GDB & gdb) {
+  // Only the worker thread refreshes, so the last snapshot and the cache need no lock
+  static DebugSnapshotPtr last_snapshot;
+  static SnapshotCache snapshot_cache;
+  IOCounters refresh_start = gdb.get_io_counters();
 
   // Queue events if gdb is alive and 
   // application has been initialized on separate thread
@@ -33,48 +63,72 @@ void update_console_and_gui(GDB & gdb) {
     if (window) { // Window will be null if GDBApp::OnInit() hasn't been called
       wxEvtHandler * handler = window->GetEventHandler();
 
-      // Update displays if we detect line numbers have changed
-      long line_number = gdb.is_running_program() ?
-        gdb.get_source_line_number() : 0;
-      long saved_line_number = gdb.get_saved_line_number();
-
-      // Set saved line number to be current line number
-      gdb.set_saved_line_number(line_number);
-
-      if (line_number != saved_line_number) {
-        // Create event objects
-        wxCommandEvent * status_bar_update =  
-          new wxCommandEvent(GDB_EVT_STATUS_BAR_UPDATE);
-        wxCommandEvent * source_code_update = 
-          new wxCommandEvent(GDB_EVT_SOURCE_CODE_UPDATE);
-        wxCommandEvent * locals_update =
-          new wxCommandEvent(GDB_EVT_LOCALS_UPDATE);
-        wxCommandEvent * params_update =
-          new wxCommandEvent(GDB_EVT_PARAMS_UPDATE);
-        wxCommandEvent * assembly_code_update =
-          new wxCommandEvent(GDB_EVT_ASSEMBLY_CODE_UPDATE);
-        wxCommandEvent * registers_update =
-          new wxCommandEvent(GDB_EVT_REGISTERS_UPDATE);
-        wxCommandEvent * stack_frame_update =
-          new wxCommandEvent(GDB_EVT_STACK_FRAME_UPDATE);
-
-        // Set contents of events
-        status_bar_update->SetString(gdb.is_running_program() ? GDB_STATUS_RUNNING : GDB_STATUS_IDLE);
-        source_code_update->SetString(gdb.get_source_code());
-        locals_update->SetString(gdb.get_local_variables());
-        params_update->SetString(gdb.get_formal_parameters());
-        assembly_code_update->SetString(gdb.get_assembly_code());
-        registers_update->SetString(gdb.get_registers());
-        stack_frame_update->SetClientData(gdb.get_stack_frame());
-
-        // Send events to GUI application
-        handler->QueueEvent(status_bar_update);
-        handler->QueueEvent(source_code_update); 
-        handler->QueueEvent(locals_update);
-        handler->QueueEvent(params_update);
-        handler->QueueEvent(assembly_code_update);
-        handler->QueueEvent(registers_update);
-        handler->QueueEvent(stack_frame_update);
+      // The thread the user activated is selected before anything is read about it
+      PanelTracker & tracker = get_panel_tracker();
+      long requested_thread;
+      if (tracker.take_thread_request(requested_thread)) {
+        gdb.select_thread(requested_thread);
+      }
+
+      // Panels go out of date as the program's state changes; selecting another
+      // thread or frame leaves the thread list as it was, and in non-stop mode
+      // another thread stopping or resuming changes nothing but the thread list
+      int changed_panels = gdb.take_state_change();
+      if (changed_panels) {
+        tracker.mark_dirty(changed_panels);
+      }
+
+      // Children the user expanded are listed before the source panel is refreshed to show them;
+      // cached source panels lack them, even if this refresh is abandoned before showing them
+      std::vector<std::string> variable_requests = tracker.take_variable_requests();
+      for (const std::string & name : variable_requests) {
+        gdb.list_variable_children(name);
+      }
+      if (!variable_requests.empty()) {
+        snapshot_cache.drop_panels(GG_PANEL_SOURCE);
+      }
+
+      // The array viewer's expression and the pages it scrolled to are read with its refresh
+      std::string array_expression;
+      if (tracker.take_array_expression(array_expression)) {
+        gdb.set_array_expression(array_expression);
+      }
+      gdb.request_array_pages(tracker.take_array_page_requests());
+
+      // Only panels on screen are queried; hidden ones wait until their tab is selected
+      // The thread list marks the selected thread, so another selection is shown even if no other panel is
+      int panels = tracker.take_panels_to_refresh();
+      bool thread_changed = last_snapshot && last_snapshot->thread != gdb.get_selected_thread();
+      if (panels || thread_changed) {
+        // Panels of a thread and frame that were shown since the thread last ran come from the cache
+        long thread = gdb.get_selected_thread();
+        long frame = gdb.get_selected_frame();
+        long thread_generation = gdb.get_stop_generation(thread);
+        int cached_panels;
+        DebugSnapshotPtr cached = snapshot_cache.find(gdb.get_stop_generation(), thread_generation,
+            thread, frame, cached_panels);
+        int queried_panels = panels & ~cached_panels;
+        StopInfo info = gdb.get_stop_info(queried_panels);
+
+        // A newer command is waiting, so this stop is stale before it could be shown;
+        // the panels are dirty again and are queried after the command, still
+        // highlighting what changed since the last stop shown
+        if (info.cancelled) {
+          tracker.mark_dirty(panels);
+          delete_stack_frame(info.stack_frame);
+          gdb.get_stats().record("refresh (cancelled)", refresh_start, gdb.get_io_counters());
+          return;
+        }
+
+        // Send the whole stop to the GUI application at once
+        last_snapshot = make_snapshot(cached ? reuse_snapshot(cached, last_snapshot) : last_snapshot, info);
+        snapshot_cache.store(thread_generation, thread, frame, cached_panels | (queried_panels & GG_PANEL_THREAD_BOUND), last_snapshot);
+        wxThreadEvent * snapshot_update = new wxThreadEvent(GDB_EVT_SNAPSHOT_UPDATE);
+        snapshot_update->SetPayload(last_snapshot);
+        handler->QueueEvent(snapshot_update);
+
+        // Time from the prompt to every display update being queued
+        gdb.get_stats().record("refresh", refresh_start, gdb.get_io_counters());
       }
     }
   }
@@ -83,17 +137,57 @@ void update_console_and_gui(GDB & gdb) {
 void open_console(int argc, char ** argv) {
   // Convert raw C string to standard library string 
   std::vector<std::string> args;
+  GDBOptions options;
+  options.use_mi = true;
+  options.direct_memory = true;
+  options.gdb_executable = GG_DEFAULT_GDB;
+  options.non_stop = false;
   for (int i = 0; i < argc; i++) {
     char * arg = argv[i];
     std::string argstr(arg);
+
+    // Our own options are consumed here rather than passed to GDB
+    if (i > 0 && !argstr.compare(0, strlen(GG_OPTION_PREFIX), GG_OPTION_PREFIX)) {
+      if (argstr == GG_OPTION_CLI) {
+        options.use_mi = false;
+      }
+      else if (argstr == GG_OPTION_NO_DIRECT_MEMORY) {
+        options.direct_memory = false;
+      }
+      else if (!argstr.compare(0, strlen(GG_OPTION_STATS_FILE), GG_OPTION_STATS_FILE)) {
+        options.stats_file = argstr.substr(strlen(GG_OPTION_STATS_FILE));
+      }
+      else if (argstr == GG_OPTION_NON_STOP) {
+        options.non_stop = true;
+      }
+      else if (!argstr.compare(0, strlen(GG_OPTION_GDB), GG_OPTION_GDB)) {
+        options.gdb_executable = argstr.substr(strlen(GG_OPTION_GDB));
+      }
+      else {
+        std::cerr << "Unknown option: " << argstr << std::endl;
+      }
+      continue;
+    }
+
     args.push_back(argstr);
   }
 
-  // Create instance of GDB
-  GDB gdb(args);
+  if (options.non_stop && !options.use_mi) {
+    std::cerr << GG_NON_STOP_NEEDS_MI << std::endl;
+    options.non_stop = false;
+  }
+
+  // Create instance of GDB, which only the worker talks to from here on
+  GDB gdb(args, options);
+  GDBWorker worker(gdb, update_gui);
+
+  // Panels that missed a stop while hidden are fetched when their tab is selected
+  PanelTracker & tracker = get_panel_tracker();
+  tracker.set_on_dirty_shown([&worker]() { worker.request_refresh(); });
 
   // Display gdb introduction to user 
-  update_console_and_gui(gdb);
+  worker.run([&]() { update_console(gdb); });
+  worker.request_refresh();
 
   // Keep track of last command executed 
   const char * last_command = nullptr; 
@@ -102,7 +196,7 @@ void open_console(int argc, char ** argv) {
   bool last_command_deletion = true;
   bool final_command_deletion = true;
 
-  while (gdb.is_alive()) {
+  while (worker.is_alive()) {
     // Read one line from stdin to process (blocking)
     const char * command = readline(GDB_PROMPT);
     last_command_deletion = true;
@@ -130,9 +224,22 @@ void open_console(int argc, char ** argv) {
       }
     }
 
-    // Execute the command and display result
-    gdb.execute(command);
-    update_console_and_gui(gdb);
+    // Statistics are printed by gg rather than passed to GDB
+    if (!strcmp(command, GG_COMMAND_STATS)) {
+      worker.run([&]() { gdb.get_stats().print(std::cout); });
+    }
+    else if (!strcmp(command, GG_COMMAND_STATS_RESET)) {
+      worker.run([&]() { gdb.get_stats().reset(); });
+    }
+    else {
+      // Execute the command and display result; the prompt comes back
+      // while the GUI is refreshed in the background
+      worker.run([&]() {
+        gdb.execute(command);
+        update_console(gdb);
+      });
+      worker.request_refresh();
+    }
 
     // Add the command to history if user executed something different previously
     if (!last_command || strcmp(command, last_command)) {
@@ -150,6 +257,17 @@ void open_console(int argc, char ** argv) {
   if (final_command_deletion) {
     delete last_command;
   }
+
+  // The worker is about to go away, so tab changes must no longer reach it
+  tracker.set_on_dirty_shown(nullptr);
+
+  // Dump the statistics of the whole session if requested
+  if (!options.stats_file.empty()) {
+    worker.run([&]() {
+      std::ofstream stats_file(options.stats_file);
+      gdb.get_stats().write_json(stats_file);
+    });
+  }
 }
 
 void open_gui(int argc, char ** argv) {
@@ -0,0 +1,276 @@
+#include <cstring>
+#include <cctype>
+
+#include "gg.hpp"
+
+// Shared empty value returned by lookups that fail.
+static const MIValue empty_value;
+
+const MIValue & MIValue::operator[](const char * name) const {
+  for (size_t i = 0; i < names.size(); i++) {
+    if (names[i] == name) {
+      return values[i];
+    }
+  }
+  return empty_value;
+}
+
+const MIValue & MIValue::operator[](size_t index) const {
+  if (index < values.size()) {
+    return values[index];
+  }
+  return empty_value;
+}
+
+bool MIValue::has(const char * name) const {
+  for (const std::string & child_name : names) {
+    if (child_name == name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+long MIValue::to_long(long fallback) const {
+  if (kind != MI_CONST || string.empty()) {
+    return fallback;
+  }
+
+  // Base 0 handles both the decimal and the 0x-prefixed hex values GDB emits
+  char * end;
+  long value = strtol(string.c_str(), &end, 0);
+  return *end ? fallback : value;
+}
+
+// Cursor over a single line of MI output used by the parsing helpers below.
+typedef struct {
+  const char * pos;
+  const char * end;
+} MICursor;
+
+// Parses a C string starting at the opening quote, handling GDB's escapes.
+static bool parse_mi_string(MICursor & cursor, std::string & out) {
+  if (cursor.pos >= cursor.end || *cursor.pos != '"') {
+    return false;
+  }
+  cursor.pos++;
+
+  while (cursor.pos < cursor.end) {
+    char c = *cursor.pos++;
+    if (c == '"') {
+      return true;
+    }
+    if (c != '\\' || cursor.pos >= cursor.end) {
+      out.push_back(c);
+      continue;
+    }
+
+    // Escaped character
+    c = *cursor.pos++;
+    switch (c) {
+      case 'n': out.push_back('\n'); break;
+      case 't': out.push_back('\t'); break;
+      case 'r': out.push_back('\r'); break;
+      case 'e': out.push_back('\033'); break;
+      case 'a': out.push_back('\a'); break;
+      case 'b': out.push_back('\b'); break;
+      case 'f': out.push_back('\f'); break;
+      case 'v': out.push_back('\v'); break;
+      default:
+        // Octal escapes are used for unprintable bytes
+        if (c >= '0' && c <= '7') {
+          int value = c - '0';
+          for (int i = 0; i < 2 && cursor.pos < cursor.end &&
+              *cursor.pos >= '0' && *cursor.pos <= '7'; i++) {
+            value = value * 8 + (*cursor.pos++ - '0');
+          }
+          out.push_back((char) value);
+        }
+        else {
+          out.push_back(c);
+        }
+    }
+  }
+
+  // Unterminated string
+  return false;
+}
+
+static bool parse_mi_value(MICursor & cursor, MIValue & value);
+
+// Parses a "name=value" pair, or a bare value when allow_bare is set (lists).
+static bool parse_mi_result(MICursor & cursor, std::string & name, MIValue & value, bool allow_bare) {
+  const char * start = cursor.pos;
+  while (cursor.pos < cursor.end && *cursor.pos != '=' &&
+      *cursor.pos != ',' && *cursor.pos != '"' &&
+      *cursor.pos != '{' && *cursor.pos != '[' &&
+      *cursor.pos != '}' && *cursor.pos != ']') {
+    cursor.pos++;
+  }
+
+  if (cursor.pos < cursor.end && *cursor.pos == '=') {
+    name.assign(start, cursor.pos - start);
+    cursor.pos++;
+  }
+  else if (allow_bare && cursor.pos == start) {
+    name.clear();
+  }
+  else {
+    return false;
+  }
+
+  return parse_mi_value(cursor, value);
+}
+
+// Parses the comma separated contents of a tuple or list up to the closing character.
+static bool parse_mi_children(MICursor & cursor, MIValue & value, char closing) {
+  cursor.pos++; // Opening brace or bracket
+
+  if (cursor.pos < cursor.end && *cursor.pos == closing) {
+    cursor.pos++;
+    return true;
+  }
+
+  while (cursor.pos < cursor.end) {
+    value.names.push_back(std::string());
+    value.values.push_back(MIValue());
+    if (!parse_mi_result(cursor, value.names.back(), value.values.back(), closing == ']')) {
+      return false;
+    }
+
+    if (cursor.pos >= cursor.end) {
+      return false;
+    }
+    if (*cursor.pos == closing) {
+      cursor.pos++;
+      return true;
+    }
+    if (*cursor.pos != ',') {
+      return false;
+    }
+    cursor.pos++;
+  }
+
+  return false;
+}
+
+static bool parse_mi_value(MICursor & cursor, MIValue & value) {
+  if (cursor.pos >= cursor.end) {
+    return false;
+  }
+
+  switch (*cursor.pos) {
+    case '"':
+      value.kind = MIValue::MI_CONST;
+      return parse_mi_string(cursor, value.string);
+    case '{':
+      value.kind = MIValue::MI_TUPLE;
+      return parse_mi_children(cursor, value, '}');
+    case '[':
+      value.kind = MIValue::MI_LIST;
+      return parse_mi_children(cursor, value, ']');
+    default:
+      return false;
+  }
+}
+
+bool parse_mi_record(const char * line, size_t length, MIRecord & record) {
+  MICursor cursor = { line, line + length };
+
+  // Trim trailing carriage return or newline
+  while (cursor.end > cursor.pos &&
+      (cursor.end[-1] == '\r' || cursor.end[-1] == '\n')) {
+    cursor.end--;
+  }
+
+  record.type = 0;
+  record.token = -1;
+  record.record_class.clear();
+  record.results = MIValue();
+  record.results.kind = MIValue::MI_TUPLE;
+
+  // The prompt terminates every group of output records
+  size_t prompt_length = strlen(GDB_MI_PROMPT);
+  if ((size_t) (cursor.end - cursor.pos) >= prompt_length &&
+      !strncmp(cursor.pos, GDB_MI_PROMPT, prompt_length)) {
+    const char * rest = cursor.pos + prompt_length;
+    while (rest < cursor.end && *rest == ' ') {
+      rest++;
+    }
+    if (rest == cursor.end) {
+      record.type = MI_RECORD_PROMPT;
+      return true;
+    }
+  }
+
+  // Optional numeric token
+  if (cursor.pos < cursor.end && isdigit(*cursor.pos)) {
+    record.token = 0;
+    while (cursor.pos < cursor.end && isdigit(*cursor.pos)) {
+      record.token = record.token * 10 + (*cursor.pos++ - '0');
+    }
+  }
+
+  if (cursor.pos >= cursor.end) {
+    return false;
+  }
+
+  char type = *cursor.pos++;
+  switch (type) {
+    case MI_RECORD_CONSOLE:
+    case MI_RECORD_TARGET:
+    case MI_RECORD_LOG:
+      // Stream records carry a single C string
+      record.type = type;
+      return record.token == -1 &&
+        parse_mi_string(cursor, record.record_class) && cursor.pos == cursor.end;
+    case MI_RECORD_RESULT:
+    case MI_RECORD_EXEC:
+    case MI_RECORD_STATUS:
+    case MI_RECORD_NOTIFY: {
+      // Class name followed by comma separated results
+      const char * start = cursor.pos;
+      while (cursor.pos < cursor.end && *cursor.pos != ',') {
+        cursor.pos++;
+      }
+      record.record_class.assign(start, cursor.pos - start);
+      if (record.record_class.empty()) {
+        return false;
+      }
+
+      while (cursor.pos < cursor.end) {
+        if (*cursor.pos != ',') {
+          return false;
+        }
+        cursor.pos++;
+
+        record.results.names.push_back(std::string());
+        record.results.values.push_back(MIValue());
+        if (!parse_mi_result(cursor, record.results.names.back(),
+              record.results.values.back(), false)) {
+          return false;
+        }
+      }
+
+      record.type = type;
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+std::string mi_quote(const std::string & value) {
+  std::string quoted("\"");
+  for (char c : value) {
+    switch (c) {
+      case '"': quoted.append("\\\""); break;
+      case '\\': quoted.append("\\\\"); break;
+      case '\n': quoted.append("\\n"); break;
+      case '\t': quoted.append("\\t"); break;
+      default: quoted.push_back(c);
+    }
+  }
+  quoted.push_back('"');
+  return quoted;
+}
@@ -0,0 +1,86 @@
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "gg.hpp"
+
+PipeReader::PipeReader(int descriptor, size_t capacity) :
+  descriptor(descriptor),
+  buffer((char *) malloc(capacity)),
+  capacity(capacity),
+  initial_capacity(capacity),
+  start(0),
+  end(0),
+  closed(false),
+  bytes_read(0),
+  read_calls(0)
+{
+  // Reads never block, so the descriptor is switched over once instead of per read
+  int flags = fcntl(descriptor, F_GETFL);
+  if (flags != -1) {
+    fcntl(descriptor, F_SETFL, flags | O_NONBLOCK);
+  }
+}
+
+PipeReader::~PipeReader() {
+  free(buffer);
+}
+
+size_t PipeReader::fill() {
+  // Reclaim the space in front of unconsumed data
+  if (start > 0) {
+    memmove(buffer, buffer + start, end - start);
+    end -= start;
+    start = 0;
+  }
+
+  // Give back the space a long line needed once it is consumed, so that one huge
+  // reply does not hold on to its memory for the rest of the session
+  if (capacity > initial_capacity && end <= initial_capacity / 2) {
+    capacity = initial_capacity;
+    buffer = (char *) realloc(buffer, capacity);
+  }
+
+  // A full buffer at this point holds a single line longer than the buffer
+  if (end == capacity) {
+    capacity *= 2;
+    buffer = (char *) realloc(buffer, capacity);
+  }
+
+  // Read straight into the free space until the pipe is empty or the buffer is full
+  size_t total = 0;
+  while (end < capacity) {
+    ssize_t count = read(descriptor, buffer + end, capacity - end);
+    read_calls++;
+    if (count > 0) {
+      end += count;
+      total += count;
+      bytes_read += count;
+    }
+    else if (count == 0) {
+      closed = true;
+      break;
+    }
+    else if (errno != EINTR) {
+      // EAGAIN means the pipe is empty; anything else means it is unusable
+      closed = errno != EAGAIN && errno != EWOULDBLOCK;
+      break;
+    }
+  }
+
+  return total;
+}
+
+bool PipeReader::next_line(BufferView & line) {
+  const char * newline = (const char *) memchr(buffer + start, '\n', end - start);
+  if (!newline) {
+    return false;
+  }
+
+  line.data = buffer + start;
+  line.length = newline - line.data;
+  start += line.length + 1;
+  return true;
+}
@@ -0,0 +1,109 @@
+#include <cstring>
+
+#include "gg.hpp"
+
+// Helper function for sharing a section with the previous snapshot if its contents did not change.
+template <class T>
+static std::shared_ptr<const T> share_section(const std::shared_ptr<const T> & previous, T & value) {
+  if (previous && *previous == value) {
+    return previous;
+  }
+  return std::make_shared<const T>(std::move(value));
+}
+
+// Helper function for comparing the position and contents of two stack frames.
+static bool same_stack_frame(const StackFrame * a, const StackFrame * b) {
+  if (!a || !b) {
+    return a == b;
+  }
+  return a->stack_pointer == b->stack_pointer &&
+    a->frame_address == b->frame_address &&
+    a->big_endian == b->big_endian &&
+    a->memory_length == b->memory_length &&
+    !memcmp(a->memory, b->memory, a->memory_length);
+}
+
+DebugSnapshotPtr make_snapshot(const DebugSnapshotPtr & previous, StopInfo & info) {
+  // Start from the previous snapshot so that sections not queried are shared
+  std::shared_ptr<DebugSnapshot> snapshot = previous ?
+    std::make_shared<DebugSnapshot>(*previous) : std::make_shared<DebugSnapshot>();
+
+  snapshot->status = share_section(snapshot->status, info.status);
+  snapshot->thread = info.thread;
+  if (info.panels & GG_PANEL_SOURCE) {
+    snapshot->source_code = share_section(snapshot->source_code, info.source_code);
+    snapshot->variables = share_section(snapshot->variables, info.variables);
+  }
+  if (info.panels & GG_PANEL_ASSEMBLY) {
+    snapshot->assembly_code = share_section(snapshot->assembly_code, info.assembly_code);
+    snapshot->registers = share_section(snapshot->registers, info.registers);
+    snapshot->changed_registers = share_section(snapshot->changed_registers, info.changed_registers);
+  }
+  if (info.panels & GG_PANEL_VECTOR) {
+    snapshot->vector_registers = share_section(snapshot->vector_registers, info.vector_registers);
+  }
+  if (info.panels & GG_PANEL_STACK) {
+    snapshot->stack_error = share_section(snapshot->stack_error, info.stack_error);
+  }
+  if (info.panels & GG_PANEL_WHOLE_STACK) {
+    snapshot->stack_frames = share_section(snapshot->stack_frames, info.stack_frames);
+  }
+  if (info.panels & GG_PANEL_ARRAY) {
+    snapshot->array = share_section(snapshot->array, info.array);
+  }
+  if (info.panels & GG_PANEL_THREADS) {
+    snapshot->threads = share_section(snapshot->threads, info.threads);
+  }
+
+  // The frame is freed with the last snapshot that uses it, even if the GUI never sees it
+  std::shared_ptr<const StackFrame> stack_frame(info.stack_frame, delete_stack_frame);
+  info.stack_frame = nullptr;
+  if ((info.panels & GG_PANEL_STACK) &&
+      !same_stack_frame(snapshot->stack_frame.get(), stack_frame.get())) {
+    snapshot->stack_frame = stack_frame;
+  }
+
+  return snapshot;
+}
+
+DebugSnapshotPtr reuse_snapshot(const DebugSnapshotPtr & cached, const DebugSnapshotPtr & latest) {
+  std::shared_ptr<DebugSnapshot> snapshot = std::make_shared<DebugSnapshot>(*cached);
+  if (latest) {
+    snapshot->status = latest->status;
+    snapshot->threads = latest->threads;
+    snapshot->array = latest->array;
+  }
+  return snapshot;
+}
+
+DebugSnapshotPtr SnapshotCache::find(long all_threads_generation, long thread_generation,
+    long thread, long frame, int & panels) {
+  // Once the program ran, every thread may be somewhere else
+  if (all_threads_generation != generation) {
+    snapshots.clear();
+    generation = all_threads_generation;
+  }
+
+  // In non-stop mode a thread that ran on its own is the only one that moved
+  std::map<std::pair<long, long>, ThreadSnapshot>::iterator found = snapshots.find(std::make_pair(thread, frame));
+  if (found == snapshots.end() || found->second.generation != thread_generation) {
+    panels = 0;
+    return nullptr;
+  }
+  panels = found->second.panels;
+  return found->second.snapshot;
+}
+
+void SnapshotCache::drop_panels(int panels) {
+  for (std::pair<const std::pair<long, long>, ThreadSnapshot> & cached : snapshots) {
+    cached.second.panels &= ~panels;
+  }
+}
+
+void SnapshotCache::store(long thread_generation, long thread, long frame, int panels,
+    const DebugSnapshotPtr & snapshot) {
+  ThreadSnapshot & cached = snapshots[std::make_pair(thread, frame)];
+  cached.snapshot = snapshot;
+  cached.panels = panels;
+  cached.generation = thread_generation;
+}
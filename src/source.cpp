@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "gg.hpp"
+
+SourceFile::SourceFile() : modified(0) {}
+
+bool SourceFile::open(const std::string & path) {
+  close();
+
+  int descriptor = ::open(path.c_str(), O_RDONLY);
+  if (descriptor == -1) {
+    return false;
+  }
+
+  struct stat status;
+  if (fstat(descriptor, &status) == -1) {
+    ::close(descriptor);
+    return false;
+  }
+  modified = status.st_mtime;
+
+  // The file is copied rather than mapped, since a mapping of a file that is
+  // truncated on disk (e.g. by an editor saving it) faults when read past its end.
+  // Reading stops at the end of the file even if it changed since fstat
+  contents.resize(status.st_size);
+  size_t length = 0;
+  while (length < contents.size()) {
+    ssize_t bytes = read(descriptor, &contents[length], contents.size() - length);
+    if (bytes == -1 && errno == EINTR) {
+      continue;
+    }
+    if (bytes <= 0) {
+      break;
+    }
+    length += bytes;
+  }
+  ::close(descriptor);
+  contents.resize(length);
+
+  // Index the start of every line
+  const char * data = contents.data();
+  size_t size = contents.size();
+  line_offsets.push_back(0);
+  for (const char * newline = data; size &&
+      (newline = (const char *) memchr(newline, '\n', data + size - newline)); newline++) {
+    line_offsets.push_back(newline + 1 - data);
+  }
+
+  // A trailing newline does not start another line
+  if (line_offsets.back() == size) {
+    line_offsets.pop_back();
+  }
+
+  return true;
+}
+
+void SourceFile::close() {
+  contents.clear();
+  contents.shrink_to_fit();
+  line_offsets.clear();
+}
+
+bool SourceFile::is_stale(const std::string & path) {
+  struct stat status;
+  return stat(path.c_str(), &status) == -1 ||
+    (size_t) status.st_size != contents.size() || status.st_mtime != modified;
+}
+
+std::string SourceFile::get_lines(long first, long last) {
+  const char * data = contents.data();
+  first = std::max(first, (long) 1);
+  last = std::min(last, line_count());
+
+  // Lines are numbered and tab separated like the output of GDB's list command
+  std::string lines;
+  for (long line = first; line <= last; line++) {
+    size_t start = line_offsets[line - 1];
+    size_t end = line < line_count() ? line_offsets[line] : contents.size();
+    lines.append(std::to_string(line)).append("\t");
+    lines.append(data + start, end - start);
+    if (end == start || data[end - 1] != '\n') {
+      lines.append("\n");
+    }
+  }
+
+  return lines;
+}
@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include "gg.hpp"
+
+// Number of linear buckets in each power of two, and the values below which
+// every value gets its own bucket.
+#define HISTOGRAM_SUB_BUCKETS (1 << GG_HISTOGRAM_PRECISION_BITS)
+#define HISTOGRAM_HALF_BUCKETS (HISTOGRAM_SUB_BUCKETS / 2)
+
+// Helper function for finding the bucket a value is counted in.
+static size_t histogram_bucket(uint64_t value) {
+  if (value < HISTOGRAM_SUB_BUCKETS) {
+    return value;
+  }
+
+  // Keep the top GG_HISTOGRAM_PRECISION_BITS bits of the value
+  int magnitude = 63 - __builtin_clzll(value);
+  int shift = magnitude - GG_HISTOGRAM_PRECISION_BITS + 1;
+  return (shift + 1) * HISTOGRAM_HALF_BUCKETS + (value >> shift) - HISTOGRAM_HALF_BUCKETS;
+}
+
+// Helper function for getting the value in the middle of a bucket.
+static uint64_t histogram_bucket_value(size_t bucket) {
+  if (bucket < HISTOGRAM_SUB_BUCKETS) {
+    return bucket;
+  }
+
+  int shift = bucket / HISTOGRAM_HALF_BUCKETS - 1;
+  uint64_t lowest = (uint64_t) (bucket % HISTOGRAM_HALF_BUCKETS + HISTOGRAM_HALF_BUCKETS) << shift;
+  return lowest + ((uint64_t) 1 << shift) / 2;
+}
+
+LatencyHistogram::LatencyHistogram() :
+  counts(histogram_bucket(UINT64_MAX) + 1, 0),
+  total_count(0),
+  minimum(UINT64_MAX),
+  maximum(0),
+  sum(0) {}
+
+void LatencyHistogram::record(uint64_t value) {
+  counts[histogram_bucket(value)]++;
+  total_count++;
+  minimum = std::min(minimum, value);
+  maximum = std::max(maximum, value);
+  sum += value;
+}
+
+uint64_t LatencyHistogram::percentile(double percentage) const {
+  if (!total_count) {
+    return 0;
+  }
+
+  // Walk the buckets until enough values have been passed
+  uint64_t target = std::max((uint64_t) 1, (uint64_t) (percentage / 100 * total_count + 0.5));
+  uint64_t seen = 0;
+  for (size_t bucket = 0; bucket < counts.size(); bucket++) {
+    seen += counts[bucket];
+    if (seen >= target) {
+      // Bucket midpoints can fall outside of the values actually recorded
+      return std::max(minimum, std::min(maximum, histogram_bucket_value(bucket)));
+    }
+  }
+  return maximum;
+}
+
+// Helper function for converting nanoseconds to microseconds.
+static uint64_t to_microseconds(uint64_t nanoseconds) {
+  return nanoseconds / 1000;
+}
+
+void GDBStats::record(const std::string & name, const IOCounters & start, const IOCounters & end) {
+  QueryStats & query = queries[name];
+  query.wall_time.record(to_microseconds(end.time - start.time));
+  query.parse_time.record(to_microseconds(end.parse_time - start.parse_time));
+  query.bytes_read += end.bytes_read - start.bytes_read;
+  query.syscalls += end.syscalls - start.syscalls;
+}
+
+// Helper function for ordering queries by their total time, the most expensive first.
+static std::vector<const std::pair<const std::string, QueryStats> *>
+    sort_queries(const std::map<std::string, QueryStats> & queries) {
+  std::vector<const std::pair<const std::string, QueryStats> *> sorted;
+  for (const std::pair<const std::string, QueryStats> & query : queries) {
+    sorted.push_back(&query);
+  }
+  std::stable_sort(sorted.begin(), sorted.end(),
+      [](const std::pair<const std::string, QueryStats> * a,
+        const std::pair<const std::string, QueryStats> * b) {
+      return a->second.wall_time.total() > b->second.wall_time.total();
+    });
+  return sorted;
+}
+
+void GDBStats::print(std::ostream & output) const {
+  if (queries.empty()) {
+    output << "No queries recorded." << std::endl;
+    return;
+  }
+
+  // Times are in microseconds; bytes and syscalls are per query
+  output << std::left << std::setw(28) << "query" << std::right
+    << std::setw(8) << "count" << std::setw(10) << "total"
+    << std::setw(9) << "p50" << std::setw(9) << "p90"
+    << std::setw(9) << "p99" << std::setw(9) << "max"
+    << std::setw(9) << "parse" << std::setw(10) << "bytes"
+    << std::setw(9) << "syscalls" << std::endl;
+
+  for (const std::pair<const std::string, QueryStats> * query : sort_queries(queries)) {
+    const QueryStats & stats = query->second;
+    uint64_t count = stats.wall_time.count();
+    output << std::left << std::setw(28) << query->first << std::right
+      << std::setw(8) << count << std::setw(10) << stats.wall_time.total()
+      << std::setw(9) << stats.wall_time.percentile(50)
+      << std::setw(9) << stats.wall_time.percentile(90)
+      << std::setw(9) << stats.wall_time.percentile(99)
+      << std::setw(9) << stats.wall_time.max()
+      << std::setw(9) << stats.parse_time.mean()
+      << std::setw(10) << stats.bytes_read / count
+      << std::setw(9) << stats.syscalls / count << std::endl;
+  }
+}
+
+// Helper function for quoting a string as JSON.
+static std::string json_quote(const std::string & value) {
+  std::ostringstream quoted;
+  quoted << '"';
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      quoted << '\\' << c;
+    }
+    else if ((unsigned char) c < 0x20) {
+      quoted << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int) c;
+    }
+    else {
+      quoted << c;
+    }
+  }
+  quoted << '"';
+  return quoted.str();
+}
+
+// Helper function for writing a histogram as a JSON object.
+static void write_histogram_json(std::ostream & output, const LatencyHistogram & histogram) {
+  output << "{\"min\": " << histogram.min()
+    << ", \"mean\": " << histogram.mean()
+    << ", \"p50\": " << histogram.percentile(50)
+    << ", \"p90\": " << histogram.percentile(90)
+    << ", \"p99\": " << histogram.percentile(99)
+    << ", \"p999\": " << histogram.percentile(99.9)
+    << ", \"max\": " << histogram.max()
+    << ", \"total\": " << histogram.total() << "}";
+}
+
+void GDBStats::write_json(std::ostream & output) const {
+  output << "{\n  \"unit\": \"microseconds\",\n  \"queries\": {";
+
+  bool first = true;
+  for (const std::pair<const std::string, QueryStats> * query : sort_queries(queries)) {
+    const QueryStats & stats = query->second;
+    output << (first ? "\n" : ",\n") << "    " << json_quote(query->first) << ": {"
+      << "\"count\": " << stats.wall_time.count()
+      << ", \"bytes_read\": " << stats.bytes_read
+      << ", \"syscalls\": " << stats.syscalls
+      << ", \"wall_time\": ";
+    write_histogram_json(output, stats.wall_time);
+    output << ", \"parse_time\": ";
+    write_histogram_json(output, stats.parse_time);
+    output << "}";
+    first = false;
+  }
+
+  output << "\n  }\n}" << std::endl;
+}
+
+// Commands gg sends whose name takes more than one word.
+static const char * const multi_word_commands[] = {
+  GDB_INFO_ARGUMENTS, GDB_INFO_LOCALS, GDB_INFO_PROGRAM, GDB_INFO_REGISTERS, GDB_INFO_INFERIORS,
+  GDB_INFO_SOURCE, GDB_INFO_FRAME, GDB_SHOW_ENDIAN, GDB_GET_LIST_SIZE, GDB_SET_LIST_SIZE,
+  GDB_MAINT_REGISTER_GROUPS, GDB_FRAME_APPLY
+};
+
+std::string query_name(const std::string & command) {
+  // Commands run in another thread or frame are named like the others
+  std::string name = command;
+  for (const char * option : { " " GDB_MI_THREAD_OPTION " ", " " GDB_MI_FRAME_OPTION " " }) {
+    size_t start = name.find(option);
+    if (start != std::string::npos) {
+      size_t end = name.find(' ', start + strlen(option));
+      name.erase(start, end == std::string::npos ? std::string::npos : end - start);
+    }
+  }
+
+  // Look inside commands wrapped for the console interpreter
+  std::string console_prefix = std::string(GDB_MI_CONSOLE) + " \"";
+  if (!name.compare(0, console_prefix.size(), console_prefix)) {
+    name = name.substr(console_prefix.size());
+  }
+
+  // MI commands are a single word, and whatever follows is options and arguments
+  // (e.g. "-var-create - @ x" or "-var-update --all-values *")
+  if (!name.compare(0, 1, "-")) {
+    return name.substr(0, name.find(' '));
+  }
+
+  // Commands of several words that gg sends are named in full, with any argument left out
+  // (e.g. "frame apply 4096 -q info frame")
+  for (const char * command_words : multi_word_commands) {
+    size_t length = strlen(command_words);
+    if (!name.compare(0, length, command_words) &&
+        (name.size() == length || name[length] == ' ' || name[length] == '"')) {
+      return command_words;
+    }
+  }
+
+  // Anything else is named by its first word, without arguments or format letters
+  // (e.g. "print var3", "x/16xb" or "list 12")
+  size_t end = 0;
+  while (end < name.size() && (isalpha(name[end]) || name[end] == '-' || name[end] == '_')) {
+    end++;
+  }
+  return name.substr(0, end);
+}
@@ -0,0 +1,97 @@
+#include "gg.hpp"
+
+std::vector<InferiorThread> parse_threads(const MIRecord & result) {
+  std::vector<InferiorThread> threads;
+  for (const MIValue & listed : result.results["threads"].values) {
+    InferiorThread thread;
+    thread.id = listed["id"].to_long(0);
+    thread.target_id = listed["target-id"].string;
+    thread.name = listed["name"].string;
+    thread.state = listed["state"].string;
+
+    // Running threads have no frame
+    const MIValue & frame = listed["frame"];
+    thread.function = frame["func"].string;
+    if (frame.has("file")) {
+      thread.location = frame["file"].string + ":" + frame["line"].string;
+    }
+    threads.push_back(thread);
+  }
+  return threads;
+}
+
+bool GDB::select_thread(long thread) {
+  if (!mi || (thread == selected_thread && selected_frame == 0)) {
+    return false;
+  }
+
+  // Selecting the thread that is already selected leaves GDB's frame where it was,
+  // e.g. after up, so its innermost frame is selected instead
+  MIRecord result;
+  if (thread == selected_thread) {
+    if (!execute_mi_and_read(std::string(GDB_MI_SELECT_FRAME) + " 0", result)) {
+      return false;
+    }
+    set_selected_thread(thread, 0);
+    frame_position_valid = false;
+    changed_panels |= GG_PANEL_ALL & ~GG_PANEL_THREADS;
+    return true;
+  }
+
+  // GDB only tells other interpreters about selections made through MI
+  if (!execute_mi_and_read(std::string(GDB_MI_SELECT_THREAD) + " " + std::to_string(thread), result)) {
+    return false;
+  }
+  const MIValue & frame = result.results["frame"];
+  set_selected_thread(result.results["new-thread-id"].to_long(thread), frame["level"].to_long(0));
+  if (result.results.has("frame")) {
+    cache_frame_position(frame);
+  }
+  else {
+    frame_position_valid = false;
+  }
+  changed_panels |= GG_PANEL_ALL & ~GG_PANEL_THREADS;
+  return true;
+}
+
+void GDB::set_selected_thread(long thread, long frame) {
+  selected_frame = frame;
+  if (thread == selected_thread) {
+    return;
+  }
+
+  // Registers are compared with the values last read in the same thread, so
+  // that switching threads does not flag every register as changed
+  std::vector<Register> saved;
+  saved.swap(register_file);
+  std::map<long, std::vector<Register>>::iterator found = thread_register_files.find(thread);
+  if (found != thread_register_files.end() && found->second.size() == saved.size()) {
+    register_file.swap(found->second);
+    for (Register & reg : register_file) {
+      reg.changed = false;
+    }
+  }
+  else {
+    register_file = saved;
+    for (Register & reg : register_file) {
+      reg.raw_value.clear();
+      reg.changed = false;
+    }
+  }
+
+  // Before any thread was selected the registers belong to no thread worth returning to
+  if (selected_thread) {
+    thread_register_files[selected_thread].swap(saved);
+  }
+  selected_thread = thread;
+  register_panels_valid = 0;
+  unshown_changes &= ~(GG_PANEL_ASSEMBLY | GG_PANEL_VECTOR);
+}
+
+std::vector<InferiorThread> GDB::list_threads() {
+  MIRecord result;
+  if (!mi || !execute_mi_and_read(GDB_MI_THREAD_INFO, result)) {
+    return std::vector<InferiorThread>();
+  }
+  return parse_threads(result);
+}
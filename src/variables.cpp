@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <set>
+
+#include "gg.hpp"
+
+// Helper function for reading a variable object from GDB's reply to
+// -var-create or from a child in its reply to -var-list-children.
+static Variable parse_variable(const MIValue & value) {
+  Variable variable;
+  variable.name = value["name"].string;
+  variable.type = value["type"].string;
+  variable.value = value["value"].string;
+  variable.child_count = value["numchild"].to_long(0);
+  variable.has_more = value["has_more"].to_long(0);
+  variable.is_argument = false;
+  variable.changed = false;
+  return variable;
+}
+
+// Helper function for adding a child listed by -var-list-children or -var-update to its parent.
+static void add_child(std::map<std::string, Variable> & variables, Variable & parent, const MIValue & child) {
+  // Elements of arrays are named by their index alone
+  bool array = !parent.type.empty() && parent.type.back() == ']';
+  Variable variable = parse_variable(child);
+  variable.parent = parent.name;
+  variable.expression = array ? "[" + child["exp"].string + "]" : child["exp"].string;
+  variable.is_argument = parent.is_argument;
+  parent.children.push_back(variable.name);
+  variables[variable.name] = variable;
+}
+
+// Helper function for adding a variable and its listed children in display order.
+static void flatten_variable(const std::map<std::string, Variable> & variables,
+    const std::string & name, std::vector<Variable> & flattened) {
+  std::map<std::string, Variable>::const_iterator found = variables.find(name);
+  if (found == variables.end()) {
+    return;
+  }
+
+  flattened.push_back(found->second);
+  for (const std::string & child : found->second.children) {
+    flatten_variable(variables, child, flattened);
+  }
+}
+
+std::vector<MIFollowUpCommand> GDB::sync_variables(const MIRecord & list) {
+  // Most stops are in the same scope as the previous one, which is checked without building anything
+  const std::vector<MIValue> & listed_variables = list.results["variables"].values;
+  bool same_scope = listed_variables.size() == listed_expressions.size();
+  for (size_t i = 0; same_scope && i < listed_variables.size(); i++) {
+    same_scope = listed_variables[i]["name"].string == listed_expressions[i];
+  }
+  if (same_scope) {
+    return std::vector<MIFollowUpCommand>();
+  }
+  listed_expressions.clear();
+  for (const MIValue & listed_variable : listed_variables) {
+    listed_expressions.push_back(listed_variable["name"].string);
+  }
+
+  std::map<std::string, std::string> shown; // Variable objects of the locals and arguments, by expression
+  for (const std::string & name : root_variables) {
+    shown[variables[name].expression] = name;
+  }
+
+  // A variable shadowed by another of the same name is listed twice, but
+  // its expression only ever evaluates to the innermost one
+  std::vector<MIFollowUpCommand> commands;
+  std::set<std::string> listed;
+  for (const MIValue & listed_variable : listed_variables) {
+    const std::string & expression = listed_variable["name"].string;
+    if (!listed.insert(expression).second || shown.count(expression)) {
+      continue;
+    }
+
+    // Floating variable objects are evaluated in whichever frame is selected.
+    // Variables that came into scope are not highlighted, like registers read for the first time
+    bool is_argument = listed_variable["arg"].to_long(0);
+    commands.push_back({ std::string(GDB_MI_CREATE_VARIABLE) + " " + mi_quote(expression),
+        [this, expression, is_argument](MIRecord & result, std::string &) {
+          if (result.record_class != "done") {
+            return;
+          }
+          Variable variable = parse_variable(result.results);
+          variable.expression = expression;
+          variable.is_argument = is_argument;
+          root_variables.push_back(variable.name);
+          variables[variable.name] = variable;
+        } });
+  }
+
+  for (const std::pair<const std::string, std::string> & root : shown) {
+    if (!listed.count(root.first)) {
+      commands.push_back({ std::string(GDB_MI_DELETE_VARIABLE) + " " + root.second, nullptr });
+      forget_variable(root.second);
+    }
+  }
+  return commands;
+}
+
+std::vector<Variable> GDB::read_variables(const MIRecord & update) {
+  // Floating variable objects are shared by every thread and frame, so after
+  // switching GDB compares with the values of the one selected before
+  bool switched = variables_thread != selected_thread || variables_frame != selected_frame;
+  variables_thread = selected_thread;
+  variables_frame = selected_frame;
+
+  // Changes GDB reported at a stop that was not shown are still changes from what is on screen
+  bool keep_changes = !switched && (unshown_changes & GG_PANEL_SOURCE);
+  for (std::pair<const std::string, Variable> & variable : variables) {
+    variable.second.changed = variable.second.changed && keep_changes;
+  }
+
+  // GDB only reports the variable objects whose value, type or number of children changed
+  for (const MIValue & change : update.results["changelist"].values) {
+    std::map<std::string, Variable>::iterator found = variables.find(change["name"].string);
+    if (found == variables.end() || change["in_scope"].string != "true") {
+      continue;
+    }
+
+    // Children of a variable whose type changed were deleted with it
+    Variable & variable = found->second;
+    if (change["type_changed"].string == "true") {
+      std::vector<std::string> children;
+      children.swap(variable.children);
+      for (const std::string & child : children) {
+        forget_variable(child);
+      }
+      variable.type = change["new_type"].string;
+    }
+    // Dynamic variable objects (e.g. containers shown by a pretty printer)
+    // change their number of children. GDB deletes the children that are gone
+    // and reports the ones that appeared among those listed so far
+    if (change.has("new_num_children")) {
+      variable.child_count = change["new_num_children"].to_long(0);
+      if ((long) variable.children.size() > variable.child_count) {
+        std::vector<std::string> orphans(variable.children.begin() + variable.child_count, variable.children.end());
+        variable.children.resize(variable.child_count);
+        for (const std::string & orphan : orphans) {
+          forget_variable(orphan);
+        }
+      }
+    }
+    for (const MIValue & child : change["new_children"].values) {
+      add_child(variables, variable, child);
+    }
+    if (change.has("has_more")) {
+      variable.has_more = change["has_more"].to_long(0);
+    }
+    variable.changed = !switched && (variable.changed || variable.value != change["value"].string);
+    variable.value = change["value"].string;
+  }
+
+  std::vector<Variable> flattened;
+  flattened.reserve(variables.size());
+  for (const std::string & name : root_variables) {
+    flatten_variable(variables, name, flattened);
+  }
+  return flattened;
+}
+
+void GDB::list_variable_children(const std::string & name) {
+  std::map<std::string, Variable>::iterator found = variables.find(name);
+  if (!mi || found == variables.end()) {
+    return;
+  }
+
+  // Only a page is listed, so that expanding a huge array or container stays cheap
+  Variable & parent = found->second;
+  long from = parent.children.size();
+  MIRecord result;
+  if (!execute_mi_and_read(std::string(GDB_MI_LIST_CHILDREN) + " " + name + " " +
+        std::to_string(from) + " " + std::to_string(from + GG_VARIABLE_PAGE_SIZE), result)) {
+    return;
+  }
+
+  for (const MIValue & child : result.results["children"].values) {
+    add_child(variables, parent, child);
+  }
+  parent.has_more = result.results["has_more"].to_long(0);
+}
+
+void GDB::forget_variable(const std::string & name) {
+  std::map<std::string, Variable>::iterator found = variables.find(name);
+  if (found == variables.end()) {
+    return;
+  }
+
+  for (const std::string & child : found->second.children) {
+    forget_variable(child);
+  }
+  if (found->second.parent.empty()) {
+    root_variables.erase(std::remove(root_variables.begin(), root_variables.end(), name), root_variables.end());
+  }
+  variables.erase(name);
+}
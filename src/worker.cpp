@@ -0,0 +1,229 @@
+#include <algorithm>
+
+#include "gg.hpp"
+
+GDBWorker::GDBWorker(GDB & gdb, std::function<void(GDB &)> refresh) :
+  gdb(gdb),
+  refresh(refresh),
+  refresh_pending(false),
+  stopping(false),
+  alive(gdb.is_alive()),
+  thread(&GDBWorker::loop, this) 
+{
+  // Refreshes give way to user commands between round trips
+  gdb.set_interrupt_check([this]() { return has_pending_jobs(); });
+}
+
+GDBWorker::~GDBWorker() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  condition.notify_all();
+  thread.join();
+  gdb.set_interrupt_check(nullptr);
+}
+
+bool GDBWorker::has_pending_jobs() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return !jobs.empty() || stopping;
+}
+
+void GDBWorker::run(std::function<void()> job) {
+  std::mutex done_mutex;
+  std::condition_variable done_condition;
+  bool done = false;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back([&]() {
+      job();
+      std::lock_guard<std::mutex> done_lock(done_mutex);
+      done = true;
+      done_condition.notify_one();
+    });
+  }
+  condition.notify_all();
+
+  std::unique_lock<std::mutex> done_lock(done_mutex);
+  done_condition.wait(done_lock, [&]() { return done; });
+}
+
+void GDBWorker::request_refresh() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    refresh_pending = true;
+  }
+  condition.notify_all();
+}
+
+void GDBWorker::loop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  std::function<bool()> has_work = [this]() { return stopping || !jobs.empty() || refresh_pending; };
+  while (true) {
+    // In non-stop mode threads stop without a command, so an idle worker keeps
+    // reading GDB's notifications and refreshes the GUI if they changed anything
+    if (gdb.is_non_stop() && alive) {
+      if (!condition.wait_for(lock, std::chrono::milliseconds(GG_NOTIFICATION_POLL_MS), has_work)) {
+        lock.unlock();
+        bool changed = gdb.read_notifications(std::cout, std::cerr);
+        alive = gdb.is_alive();
+        lock.lock();
+        refresh_pending = refresh_pending || changed;
+        continue;
+      }
+    }
+    else {
+      condition.wait(lock, has_work);
+    }
+
+    // User commands always go first
+    if (!jobs.empty()) {
+      std::function<void()> job = std::move(jobs.front());
+      jobs.pop_front();
+      lock.unlock();
+      job();
+      alive = gdb.is_alive();
+      lock.lock();
+    }
+    else if (stopping) {
+      break;
+    }
+    else if (refresh_pending) {
+      refresh_pending = false;
+      lock.unlock();
+      if (gdb.is_alive()) {
+        refresh(gdb);
+      }
+      alive = gdb.is_alive();
+      lock.lock();
+    }
+  }
+}
+
+void PanelTracker::set_visible(int panels) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    visible = panels;
+  }
+  mark_dirty_and_notify(0, false);
+}
+
+void PanelTracker::set_on_dirty_shown(std::function<void()> callback) {
+  std::unique_lock<std::mutex> lock(mutex);
+  on_dirty_shown = callback;
+
+  // Calls already under way may still reach whatever the old callback refers to
+  callbacks_done.wait(lock, [this]() { return !running_callbacks; });
+}
+
+void PanelTracker::mark_dirty_and_notify(int panels, bool force) {
+  std::function<void()> callback;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    dirty |= panels;
+    if (on_dirty_shown && (force || (dirty & visible))) {
+      callback = on_dirty_shown;
+      running_callbacks++;
+    }
+  }
+
+  // Called without the lock, since it hands work to the worker
+  if (callback) {
+    callback();
+    std::lock_guard<std::mutex> lock(mutex);
+    running_callbacks--;
+    callbacks_done.notify_all();
+  }
+}
+
+void PanelTracker::mark_dirty(int panels) {
+  std::lock_guard<std::mutex> lock(mutex);
+  dirty |= panels;
+}
+
+int PanelTracker::take_panels_to_refresh() {
+  std::lock_guard<std::mutex> lock(mutex);
+  int panels = dirty & visible;
+  dirty &= ~panels;
+  return panels;
+}
+
+void PanelTracker::request_variable_children(const std::string & name) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (std::find(variable_requests.begin(), variable_requests.end(), name) == variable_requests.end()) {
+      variable_requests.push_back(name);
+    }
+  }
+  mark_dirty_and_notify(GG_PANEL_SOURCE, false);
+}
+
+std::vector<std::string> PanelTracker::take_variable_requests() {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<std::string> requests;
+  requests.swap(variable_requests);
+  return requests;
+}
+
+void PanelTracker::request_array(const std::string & expression) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    array_expression = expression;
+    array_expression_set = true;
+
+    // Pages of the previous array are no use once it is replaced
+    array_page_requests.clear();
+  }
+  mark_dirty_and_notify(GG_PANEL_ARRAY, false);
+}
+
+void PanelTracker::request_array_page(long page) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    array_page_requests.push_back(page);
+  }
+  mark_dirty_and_notify(GG_PANEL_ARRAY, false);
+}
+
+bool PanelTracker::take_array_expression(std::string & expression) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!array_expression_set) {
+    return false;
+  }
+  expression = array_expression;
+  array_expression_set = false;
+  return true;
+}
+
+std::vector<long> PanelTracker::take_array_page_requests() {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<long> requests;
+  requests.swap(array_page_requests);
+  return requests;
+}
+
+void PanelTracker::request_thread(long thread) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    thread_request = thread;
+  }
+
+  // The thread is selected by the refresh even when no panel showing it is on screen
+  mark_dirty_and_notify(GG_PANEL_THREAD_BOUND | GG_PANEL_ARRAY, true);
+}
+
+bool PanelTracker::take_thread_request(long & thread) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!thread_request) {
+    return false;
+  }
+  thread = thread_request;
+  thread_request = 0;
+  return true;
+}
+
+PanelTracker & get_panel_tracker() {
+  static PanelTracker tracker;
+  return tracker;
+}
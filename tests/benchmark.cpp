@@ -0,0 +1,184 @@
+// Measures how long gg takes to refresh after the inferior stops, by driving
+// the GDB class against build/mockgdb through a set of scenarios.
+// Usage: benchmark <mockgdb> [stops per scenario]
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+#include <sys/resource.h>
+
+#include "../src/gg.hpp"
+
+#define BENCHMARK_DEFAULT_STOPS 200
+#define BENCHMARK_TABS (GG_PANEL_SOURCE | GG_PANEL_ASSEMBLY | GG_PANEL_STACK) // Every tab, vectors collapsed
+
+// Heap allocations made by this process, counted by the operator new below.
+static uint64_t allocations = 0;
+
+void * operator new(size_t size) {
+  allocations++;
+  void * memory = malloc(size ? size : 1);
+  if (!memory) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void * memory) noexcept {
+  free(memory);
+}
+
+// A debugging session with a particular shape.
+typedef struct {
+  const char * name;
+  std::vector<std::string> mock_options; // Options passed to mockgdb
+  bool direct_memory; // Read the stack with process_vm_readv instead of through MI
+  int panels; // GG_PANEL_* flags of the panels on screen
+  const char * array; // Expression shown in the array viewer, which scrolls a page at every stop
+  long threads; // Threads selected in turn at every stop, twice over, after the first
+  bool non_stop; // Run GDB in non-stop mode, where workers stop in the background as the first thread steps
+} Scenario;
+
+// Helper function for getting the CPU time used by this process in microseconds.
+static uint64_t cpu_microseconds() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000L +
+    usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// Helper function for getting the steady clock time in microseconds.
+static uint64_t wall_microseconds() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Helper function for doing the same work as update_gui in main.cpp, minus the GUI.
+static void refresh(GDB & gdb, SnapshotCache & cache, DebugSnapshotPtr & snapshot, int panels) {
+  panels &= gdb.take_state_change();
+  if (!panels) {
+    return;
+  }
+
+  long thread = gdb.get_selected_thread();
+  long frame = gdb.get_selected_frame();
+  long thread_generation = gdb.get_stop_generation(thread);
+  int cached_panels;
+  DebugSnapshotPtr cached = cache.find(gdb.get_stop_generation(), thread_generation, thread, frame, cached_panels);
+  StopInfo info = gdb.get_stop_info(panels & ~cached_panels);
+  snapshot = make_snapshot(cached ? reuse_snapshot(cached, snapshot) : snapshot, info);
+  cache.store(thread_generation, thread, frame, cached_panels | (info.panels & GG_PANEL_THREAD_BOUND), snapshot);
+}
+
+// Runs a scenario, printing one row of results.
+static void run_scenario(const char * mockgdb, const Scenario & scenario, long stops) {
+  std::vector<std::string> args;
+  args.push_back(mockgdb);
+  args.insert(args.end(), scenario.mock_options.begin(), scenario.mock_options.end());
+
+  GDBOptions options;
+  options.use_mi = true;
+  options.direct_memory = scenario.direct_memory;
+  options.gdb_executable = mockgdb;
+  options.non_stop = scenario.non_stop;
+  GDB gdb(args, options);
+
+  // Output is discarded; only the time taken to produce it matters
+  std::ostringstream discard;
+  gdb.read_until_prompt(discard, discard, true);
+  gdb.execute("run");
+  gdb.read_until_prompt(discard, discard, true);
+  if (scenario.array) {
+    gdb.set_array_expression(scenario.array);
+  }
+
+  DebugSnapshotPtr snapshot; // Last snapshot handed to the (absent) GUI
+  SnapshotCache cache; // Snapshots of the threads selected since the last stop
+  LatencyHistogram prompt_latency; // Time until the console would show the prompt again
+  LatencyHistogram latency; // Time until everything the GUI shows has been fetched
+  uint64_t cpu_start = cpu_microseconds();
+  uint64_t allocations_start = allocations;
+  for (long i = 0; i < stops && gdb.is_alive(); i++) {
+    uint64_t start = wall_microseconds();
+
+    // Same work as update_console in main.cpp
+    gdb.execute("next");
+    gdb.read_until_prompt(discard, discard, true);
+    prompt_latency.record(wall_microseconds() - start);
+    if (scenario.array) {
+      gdb.request_array_pages({ i });
+    }
+    refresh(gdb, cache, snapshot, scenario.panels);
+
+    // The second time around every thread is served from the cache; selecting
+    // a thread leaves the thread list as it was
+    for (long thread = 0; thread < 2 * scenario.threads; thread++) {
+      gdb.select_thread(thread % scenario.threads + 1);
+      refresh(gdb, cache, snapshot, scenario.panels);
+    }
+
+    latency.record(wall_microseconds() - start);
+    discard.str(std::string());
+  }
+  uint64_t cpu_time = cpu_microseconds() - cpu_start;
+  uint64_t allocations_made = allocations - allocations_start;
+
+  long count = std::max((uint64_t) 1, latency.count());
+  std::cout << std::left << std::setw(16) << scenario.name << std::right
+    << std::setw(8) << latency.count()
+    << std::setw(10) << prompt_latency.percentile(50)
+    << std::setw(10) << latency.percentile(50)
+    << std::setw(10) << latency.percentile(99)
+    << std::setw(10) << latency.max()
+    << std::setw(12) << cpu_time / count
+    << std::setw(12) << allocations_made / count << std::endl;
+
+  gdb.execute(GDB_QUIT);
+}
+
+int main(int argc, char ** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <mockgdb> [stops per scenario]" << std::endl;
+    return 1;
+  }
+  const char * mockgdb = argv[1];
+  long stops = argc > 2 ? atol(argv[2]) : BENCHMARK_DEFAULT_STOPS;
+
+  std::vector<Scenario> scenarios = {
+    { "baseline", {}, true, BENCHMARK_TABS, nullptr, 0, false },
+    { "source-tab-only", {}, true, GG_PANEL_SOURCE, nullptr, 0, false },
+    { "stack-via-mi", {}, false, BENCHMARK_TABS, nullptr, 0, false },
+    { "deep-stack", { "--mock-stack-size=65536" }, true, BENCHMARK_TABS, nullptr, 0, false },
+    { "huge-function", { "--mock-function-size=20000" }, true, BENCHMARK_TABS, nullptr, 0, false },
+    { "many-locals", { "--mock-locals=5000" }, true, BENCHMARK_TABS, nullptr, 0, false },
+    { "no-source-file", { "--mock-source-lines=0" }, true, BENCHMARK_TABS, nullptr, 0, false },
+    { "slow-gdb", { "--mock-delay-us=200" }, true, BENCHMARK_TABS, nullptr, 0, false },
+    { "vector-registers", {}, true, GG_PANEL_ASSEMBLY | GG_PANEL_VECTOR, nullptr, 0, false },
+    { "slow-source-only", { "--mock-delay-us=200" }, true, GG_PANEL_SOURCE, nullptr, 0, false },
+    { "whole-stack", { "--mock-frames=500", "--mock-stack-size=96" }, true, GG_PANEL_STACK | GG_PANEL_WHOLE_STACK, nullptr, 0, false },
+    { "array-viewer", { "--mock-array-length=1048576" }, true, GG_PANEL_ARRAY, "values", 0, false },
+    { "array-via-mi", { "--mock-array-length=1048576" }, false, GG_PANEL_ARRAY, "values", 0, false },
+    { "transcript", { "--mock-transcript=tests/transcripts/registers.mi" }, true, BENCHMARK_TABS, nullptr, 0, false },
+    { "thread-switch", { "--mock-threads=64" }, true, BENCHMARK_TABS | GG_PANEL_THREADS, nullptr, 8, false },
+    { "non-stop", { "--mock-threads=64" }, true, BENCHMARK_TABS | GG_PANEL_THREADS, nullptr, 0, true },
+  };
+
+  // Latencies are in microseconds; "prompt" is the median time until the
+  // console is usable again and the rest cover the whole refresh;
+  // CPU time and allocations are per stop
+  std::cout << std::left << std::setw(16) << "scenario" << std::right
+    << std::setw(8) << "stops" << std::setw(10) << "prompt"
+    << std::setw(10) << "p50" << std::setw(10) << "p99"
+    << std::setw(10) << "max" << std::setw(12) << "cpu/stop"
+    << std::setw(12) << "allocs/stop" << std::endl;
+
+  for (const Scenario & scenario : scenarios) {
+    run_scenario(mockgdb, scenario, stops);
+  }
+
+  return 0;
+}
@@ -0,0 +1,898 @@
+// Scripted stand-in for GDB used by the benchmark.
+// Speaks just enough GDB/MI to drive gg through a debugging session,
+// generating replies whose size and delay are set by the options below,
+// or replaying replies recorded in a transcript file.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <signal.h>
+#include <unistd.h>
+
+#define MOCK_OPTION_DELAY "--mock-delay-us="
+#define MOCK_OPTION_LOCALS "--mock-locals="
+#define MOCK_OPTION_ARRAY_LENGTH "--mock-array-length="
+#define MOCK_OPTION_FUNCTION_SIZE "--mock-function-size="
+#define MOCK_OPTION_STACK_SIZE "--mock-stack-size="
+#define MOCK_OPTION_FRAMES "--mock-frames="
+#define MOCK_OPTION_THREADS "--mock-threads="
+#define MOCK_OPTION_SOURCE_LINES "--mock-source-lines="
+#define MOCK_OPTION_TRANSCRIPT "--mock-transcript="
+
+#define MOCK_CONSOLE "-interpreter-exec console "
+#define MOCK_NON_STOP "set non-stop on" // Command given with -ex that turns on non-stop mode
+#define MOCK_FUNCTION_START 0x401000
+#define MOCK_INSTRUCTION_SIZE 4
+#define MOCK_GENERAL_GROUPS "general,all,save,restore"
+#define MOCK_WORKER_LINE 3 // Line every thread but the first waits at
+
+// Reply recorded in a transcript for commands starting with a prefix.
+typedef struct {
+  std::string prefix;
+  std::vector<std::string> lines;
+} MockReply;
+
+// Scenario being played, set from the command line.
+typedef struct {
+  long delay_us; // Delay before every reply
+  long locals; // Number of local variables
+  long array_length; // Elements in the "values" array, also a local variable
+  long function_size; // Number of instructions in the function
+  long stack_size; // Bytes between the stack pointer and the canonical frame address
+  long frames; // Frames on the stack, each stack_size bytes, all but the outermost in "recurse"
+  long threads; // Threads of the program; all but the first wait in "worker"
+  long source_lines; // Lines in the generated source file, or 0 for no file
+  std::vector<MockReply> transcript; // Replies that take priority over generated ones
+} MockScenario;
+
+static MockScenario scenario = { 0, 10, 100000, 100, 256, 1, 1, 200, {} };
+static std::vector<uint8_t> stack; // Memory the stack pointer points into
+static std::vector<int32_t> values; // Memory of the "values" array
+static std::string source_path; // Generated source file, removed on exit
+static long line_number = 1;
+static long frame_level = 0; // Frame given with --frame to the command being answered
+static long selected_thread = 1;
+static bool running = false;
+static bool non_stop = false; // In non-stop mode the workers run, except for the one that last hit a breakpoint
+static long stopped_worker = 0; // Worker stopped at a breakpoint in non-stop mode, or 0
+static bool main_running = false; // Set when the main thread was continued in the background in non-stop mode
+
+// Quotes a string as an MI C string.
+static std::string quote(const std::string & value) {
+  std::string quoted("\"");
+  for (char c : value) {
+    switch (c) {
+      case '"': quoted.append("\\\""); break;
+      case '\\': quoted.append("\\\\"); break;
+      case '\n': quoted.append("\\n"); break;
+      case '\t': quoted.append("\\t"); break;
+      default: quoted.push_back(c);
+    }
+  }
+  quoted.push_back('"');
+  return quoted;
+}
+
+// Removes the quotes and escapes from an MI C string.
+static std::string unquote(const std::string & value) {
+  std::string unquoted;
+  for (size_t i = 1; i + 1 < value.size(); i++) {
+    if (value[i] == '\\' && i + 2 < value.size()) {
+      i++;
+    }
+    unquoted.push_back(value[i]);
+  }
+  return unquoted;
+}
+
+// Writes console output as a stream record.
+static void console(const std::string & text) {
+  std::cout << "~" << quote(text) << "\n";
+}
+
+// Writes a result record followed by the prompt, which ends the reply.
+static void result(const std::string & token, const std::string & record) {
+  std::cout << token << record << "\n(gdb) \n" << std::flush;
+}
+
+// Returns true if a thread is running in the background, which only happens in non-stop mode.
+static bool thread_running(long thread) {
+  return non_stop && running && (thread == 1 ? main_running : thread != stopped_worker);
+}
+
+// Gets the line a thread is at.
+static long thread_line(long thread) {
+  return thread == 1 ? line_number : MOCK_WORKER_LINE;
+}
+
+static long program_counter() {
+  return MOCK_FUNCTION_START + ((thread_line(selected_thread) - 1) % scenario.function_size) * MOCK_INSTRUCTION_SIZE;
+}
+
+static std::string hex(long value) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "0x%lx", value);
+  return buffer;
+}
+
+// Gets a frame of the selected thread, the innermost one by default.
+static std::string frame(long level = 0) {
+  std::string fullname = source_path.empty() ? "" : ",fullname=" + quote(source_path);
+  return "frame={level=\"" + std::to_string(level) + "\",addr=\"" + hex(program_counter()) +
+    "\",func=\"" + (selected_thread == 1 ? "main" : "worker") + "\",file=\"mock.c\"" + fullname +
+    ",line=\"" + std::to_string(thread_line(selected_thread)) + "\"}";
+}
+
+// Register of the mock inferior and the groups GDB would put it in.
+typedef struct {
+  std::string name;
+  const char * groups;
+} MockRegister;
+
+// Gets the registers in GDB's numbering: the general ones, then vector ones, then a pseudo register.
+static const std::vector<MockRegister> & mock_registers() {
+  static std::vector<MockRegister> registers;
+  if (registers.empty()) {
+    for (const char * name : { "rax", "rbx", "rcx", "rdx", "rsi", "rdi", "rbp", "rsp", "r8", "r9",
+        "r10", "r11", "r12", "r13", "r14", "r15", "rip", "eflags", "cs", "ss", "ds", "es", "fs", "gs" }) {
+      registers.push_back({ name, MOCK_GENERAL_GROUPS });
+    }
+    for (int i = 0; i < 16; i++) {
+      registers.push_back({ "xmm" + std::to_string(i), "sse,vector,all,save,restore" });
+    }
+    registers.push_back({ "mxcsr", "sse,vector,all,save,restore" });
+    registers.push_back({ "eax", "" });
+  }
+  return registers;
+}
+
+// Prints the lanes of a 16 byte vector as GDB does, e.g. "v16_int8 = {0x1, 0x0 <repeats 15 times>}".
+static std::string vector_lanes(const uint8_t * bytes, int size, bool raw) {
+  std::vector<long> lanes;
+  for (int offset = 0; offset < 16; offset += size) {
+    long lane = 0;
+    for (int i = size - 1; i >= 0; i--) {
+      lane = lane << 8 | bytes[offset + i];
+    }
+    lanes.push_back(lane);
+  }
+
+  // Runs of at least ten equal lanes are abbreviated
+  std::string text = "v" + std::to_string(16 / size) + "_int" + std::to_string(size * 8) + " = {";
+  for (size_t i = 0; i < lanes.size();) {
+    size_t run = 1;
+    while (i + run < lanes.size() && lanes[i + run] == lanes[i]) {
+      run++;
+    }
+    size_t repeats = run >= 10 ? run : 1;
+    text.append(i ? ", " : "").append(raw ? hex(lanes[i]) : std::to_string(lanes[i]));
+    if (repeats > 1) {
+      text.append(" <repeats " + std::to_string(repeats) + " times>");
+    }
+    i += repeats;
+  }
+  return text + "}";
+}
+
+// Gets a register's value in hexadecimal or as GDB prints it naturally.
+// Like real code stepping through a loop, only a few registers change at each line.
+static std::string register_value(size_t number, bool raw) {
+  const std::string & name = mock_registers()[number].name;
+  long stack_pointer = (long) stack.data();
+  long value = 0x1000 + number;
+  if (name == "rip") {
+    long offset = program_counter() - MOCK_FUNCTION_START;
+    return raw ? hex(program_counter()) : hex(program_counter()) + " <main+" + std::to_string(offset) + ">";
+  }
+  else if (name == "eflags") {
+    return raw ? hex(line_number % 2 ? 0x246 : 0x202) : line_number % 2 ? "[ IF ZF PF ]" : "[ IF ]";
+  }
+  else if (!name.compare(0, 3, "xmm")) {
+    // The low lane counts lines, so one vector register changes at every step
+    uint8_t bytes[16] = { (uint8_t) line_number, (uint8_t) (line_number >> 8), 0, 0, (uint8_t) number };
+    return "{" + vector_lanes(bytes, 1, raw) + ", " + vector_lanes(bytes, 2, raw) + ", " +
+      vector_lanes(bytes, 4, raw) + ", " + vector_lanes(bytes, 8, raw) + ", uint128 = " + 
+      (raw ? hex(bytes[0] | bytes[1] << 8 | (long) number << 32) : std::to_string(bytes[0] | bytes[1] << 8 | (long) number << 32)) + "}";
+  }
+  else if (name == "rax") value = thread_line(selected_thread);
+  else if (name == "rbx") value = selected_thread;
+  else if (name == "rsp") value = stack_pointer;
+  else if (name == "rbp") value = stack_pointer + scenario.stack_size;
+  return raw || name == "rsp" || name == "rbp" ? hex(value) : std::to_string(value);
+}
+
+// Answers -data-list-changed-registers with the registers whose value differs
+// from when it was last asked, like GDB does.
+static void list_changed_registers(const std::string & token) {
+  static std::vector<std::string> last_values;
+  std::vector<std::string> values;
+  std::string changed;
+  for (size_t i = 0; i < mock_registers().size(); i++) {
+    values.push_back(register_value(i, true));
+    if (i >= last_values.size() || last_values[i] != values[i]) {
+      changed.append(changed.empty() ? "\"" : ",\"").append(std::to_string(i)).append("\"");
+    }
+  }
+  last_values.swap(values);
+  result(token, "^done,changed-registers=[" + changed + "]");
+}
+
+// Answers -data-list-register-values [--skip-unavailable] <format> [numbers...].
+static void list_register_values(const std::string & token, const std::string & arguments) {
+  std::istringstream words(arguments);
+  std::string format;
+  while (words >> format && !format.compare(0, 2, "--")) {}
+
+  std::vector<size_t> numbers;
+  for (size_t number; words >> number;) {
+    numbers.push_back(number);
+  }
+  if (numbers.empty()) {
+    for (size_t i = 0; i < mock_registers().size(); i++) {
+      numbers.push_back(i);
+    }
+  }
+
+  std::string values;
+  for (size_t number : numbers) {
+    if (number >= mock_registers().size()) {
+      continue;
+    }
+    values.append(values.empty() ? "" : ",").append("{number=\"" + std::to_string(number) + 
+        "\",value=" + quote(register_value(number, format != "N")) + "}");
+  }
+  result(token, "^done,register-values=[" + values + "]");
+}
+
+// Gets the value of a local variable. Like real code, a step only changes
+// a few of them: local_0 counts lines and the rest keep their value.
+static long local_value(long index) {
+  return index ? index : line_number;
+}
+
+// Variable object created by -var-create or listed by -var-list-children.
+typedef struct {
+  std::string expression; // Expression in the mock program, e.g. "local_3" or "values[12]"
+  std::string value; // Value when GDB last reported it
+} MockVariable;
+
+static std::map<std::string, MockVariable> variables; // Variable objects by name
+static long next_variable = 1;
+
+// Gets the type, value and number of children of an expression, returning
+// false if there is no such variable. The first array element counts lines.
+static bool variable_info(const std::string & expression, std::string & type, std::string & value, long & children) {
+  children = 0;
+  type = "int";
+  if (expression == "argc") {
+    value = "1";
+  }
+  else if (expression == "argv") {
+    type = "char **";
+    value = "0x7fffffffe0a8";
+  }
+  else if (expression == "values" && scenario.array_length) {
+    type = "int [" + std::to_string(scenario.array_length) + "]";
+    value = "[" + std::to_string(scenario.array_length) + "]";
+    children = scenario.array_length;
+  }
+  else if (!expression.compare(0, strlen("values["), "values[")) {
+    long index = atol(expression.c_str() + strlen("values["));
+    value = std::to_string(index < (long) values.size() ? values[index] : 0);
+  }
+  else if (!expression.compare(0, strlen("local_"), "local_") && 
+      atol(expression.c_str() + strlen("local_")) < scenario.locals) {
+    value = std::to_string(local_value(atol(expression.c_str() + strlen("local_"))));
+  }
+  else {
+    return false;
+  }
+  return true;
+}
+
+// Answers -stack-list-variables with the arguments and locals of the frame.
+static void list_variables(const std::string & token) {
+  std::string list = "{name=\"argc\",arg=\"1\"},{name=\"argv\",arg=\"1\"}";
+  for (long i = 0; i < scenario.locals; i++) {
+    list.append(",{name=\"local_" + std::to_string(i) + "\"}");
+  }
+  if (scenario.array_length) {
+    list.append(",{name=\"values\"}");
+  }
+  result(token, "^done,variables=[" + list + "]");
+}
+
+// Answers -var-create - @ <expression>.
+static void create_variable(const std::string & token, const std::string & arguments) {
+  std::string expression = unquote(arguments.substr(arguments.find('"')));
+  std::string type;
+  std::string value;
+  long children;
+  if (!variable_info(expression, type, value, children)) {
+    result(token, "^error,msg=" + quote("No symbol \"" + expression + "\" in current context."));
+    return;
+  }
+
+  std::string name = "var" + std::to_string(next_variable++);
+  variables[name] = { expression, value };
+  result(token, "^done,name=\"" + name + "\",numchild=\"" + std::to_string(children) + "\",value=" + 
+      quote(value) + ",type=" + quote(type) + ",thread-id=\"1\",has_more=\"0\"");
+}
+
+// Answers -var-update with the variable objects whose value changed since it was last asked.
+static void update_variables(const std::string & token) {
+  std::string changes;
+  for (std::pair<const std::string, MockVariable> & variable : variables) {
+    std::string type;
+    std::string value;
+    long children;
+    variable_info(variable.second.expression, type, value, children);
+    if (value != variable.second.value) {
+      variable.second.value = value;
+      changes.append(changes.empty() ? "" : ",").append("{name=\"" + variable.first + "\",value=" + 
+          quote(value) + ",in_scope=\"true\",type_changed=\"false\",has_more=\"0\"}");
+    }
+  }
+  result(token, "^done,changelist=[" + changes + "]");
+}
+
+// Answers -var-list-children --all-values <name> <from> <to>, for the array.
+static void list_children(const std::string & token, const std::string & arguments) {
+  std::istringstream words(arguments);
+  std::string name;
+  long from = 0;
+  long to = 0;
+  while (words >> name && !name.compare(0, 2, "--")) {}
+  words >> from >> to;
+
+  std::map<std::string, MockVariable>::iterator parent = variables.find(name);
+  if (parent == variables.end()) {
+    result(token, "^error,msg=\"Variable object not found\"");
+    return;
+  }
+
+  std::string children;
+  long count = 0;
+  for (long i = from; i < to && i < scenario.array_length && parent->second.expression == "values"; i++, count++) {
+    std::string child = name + "." + std::to_string(i);
+    std::string type;
+    std::string value;
+    long grandchildren;
+    variable_info("values[" + std::to_string(i) + "]", type, value, grandchildren);
+    variables[child] = { "values[" + std::to_string(i) + "]", value };
+    children.append(count ? "," : "").append("child={name=\"" + child + "\",exp=\"" + std::to_string(i) + 
+        "\",numchild=\"0\",value=" + quote(value) + ",type=\"int\",thread-id=\"1\"}");
+  }
+  result(token, "^done,numchild=\"" + std::to_string(count) + "\",children=[" + children + "],has_more=\"0\"");
+}
+
+// Answers -var-delete <name>, which deletes the children too.
+static void delete_variable(const std::string & token, const std::string & name) {
+  long deleted = 0;
+  for (std::map<std::string, MockVariable>::iterator variable = variables.begin(); variable != variables.end();) {
+    if (variable->first == name || !variable->first.compare(0, name.size() + 1, name + ".")) {
+      variable = variables.erase(variable);
+      deleted++;
+    }
+    else {
+      variable++;
+    }
+  }
+  result(token, "^done,ndeleted=\"" + std::to_string(deleted) + "\"");
+}
+
+// Resumes and stops the inferior, as run, next and friends do.
+static void resume(const std::string & token, bool start) {
+  main_running = false;
+  if (start) {
+    std::cout << "=thread-group-started,id=\"i1\",pid=\"" << getpid() << "\"\n";
+    std::cout << "=thread-created,id=\"1\",group-id=\"i1\"\n";
+    line_number = 1;
+    running = true;
+  }
+  else {
+    line_number = scenario.source_lines ? line_number % scenario.source_lines + 1 : line_number + 1;
+  }
+  if (!values.empty()) {
+    values[0] = line_number;
+  }
+
+  if (!non_stop) {
+    // Like GDB in all-stop mode, the thread that stopped is selected
+    selected_thread = 1;
+    std::cout << token << "^running\n*running,thread-id=\"all\"\n(gdb) \n";
+    std::cout << "*stopped,reason=\"end-stepping-range\"," << frame() <<
+      ",thread-id=\"1\",stopped-threads=\"all\"\n(gdb) \n" << std::flush;
+    return;
+  }
+
+  // Only the selected thread steps; meanwhile the stopped worker resumes and
+  // another one hits a breakpoint, which leaves the selection alone
+  long stepping = start ? 1 : selected_thread;
+  selected_thread = stepping;
+  std::cout << token << "^running\n*running,thread-id=\"" << (start ? "all" : std::to_string(stepping)) << "\"\n(gdb) \n";
+  if (scenario.threads > 1) {
+    if (stopped_worker && stopped_worker != stepping) {
+      std::cout << "*running,thread-id=\"" << stopped_worker << "\"\n";
+    }
+    stopped_worker = line_number % (scenario.threads - 1) + 2;
+    if (stopped_worker != stepping) {
+      selected_thread = stopped_worker;
+      std::cout << "*stopped,reason=\"breakpoint-hit\",disp=\"keep\",bkptno=\"1\"," << frame() <<
+        ",thread-id=\"" << stopped_worker << "\",stopped-threads=[\"" << stopped_worker << "\"]\n";
+      selected_thread = stepping;
+    }
+  }
+  std::cout << "*stopped,reason=\"end-stepping-range\"," << frame() <<
+    ",thread-id=\"" << stepping << "\",stopped-threads=[\"" << stepping << "\"]\n(gdb) \n" << std::flush;
+}
+
+// Answers -data-evaluate-expression for what gg asks about the "values" array.
+// It is a plain array, so the members of a std::vector are not found.
+static void evaluate_array(const std::string & token, const std::string & expression) {
+  if (expression.find("_M_impl") != std::string::npos) {
+    result(token, "^error,msg=\"There is no member named _M_impl.\"");
+  }
+  else if (expression.find("sizeof(") != std::string::npos && expression.find('/') != std::string::npos) {
+    result(token, "^done,value=\"" + std::to_string(values.size()) + "\"");
+  }
+  else if (expression.find("sizeof(") != std::string::npos) {
+    result(token, "^done,value=\"" + std::to_string(sizeof(int32_t)) + "\"");
+  }
+  else {
+    result(token, "^done,value=\"" + std::to_string((long) values.data()) + "\"");
+  }
+}
+
+static void disassemble(const std::string & token) {
+  std::string dump = "Dump of assembler code for function main:\n";
+  for (long i = 0; i < scenario.function_size; i++) {
+    long address = MOCK_FUNCTION_START + i * MOCK_INSTRUCTION_SIZE;
+    char line[96];
+    snprintf(line, sizeof(line), "%s0x%016lx <+%ld>:\tmov    %%rax,0x%lx(%%rbp)\n",
+        address == program_counter() ? "=> " : "   ", address, i * MOCK_INSTRUCTION_SIZE, i);
+    dump.append(line);
+  }
+  dump.append("End of assembler dump.\n");
+  console(dump);
+  result(token, "^done");
+}
+
+static void read_memory(const std::string & token, const std::string & arguments) {
+  long address = 0;
+  long length = 0;
+  sscanf(arguments.c_str(), "%ld %ld", &address, &length);
+
+  // Memory outside of the stack and the array reads as zero
+  static const char digits[] = "0123456789abcdef";
+  std::string contents;
+  long base = (long) stack.data();
+  long values_base = (long) values.data();
+  for (long i = 0; i < length; i++) {
+    long offset = address + i - base;
+    long values_offset = address + i - values_base;
+    uint8_t byte = offset >= 0 && offset < (long) stack.size() ? stack[offset] : 
+      values_offset >= 0 && values_offset < (long) (values.size() * sizeof(int32_t)) ? 
+      ((uint8_t *) values.data())[values_offset] : 0;
+    contents.push_back(digits[byte >> 4]);
+    contents.push_back(digits[byte & 15]);
+  }
+  result(token, "^done,memory=[{begin=\"" + hex(address) + "\",offset=\"0x0\",end=\"" +
+      hex(address + length) + "\",contents=\"" + contents + "\"}]");
+}
+
+// Answers -thread-info with every thread, the first being the one that steps.
+static void list_threads(const std::string & token) {
+  long selected = selected_thread;
+  std::string list;
+  for (long thread = 1; thread <= scenario.threads; thread++) {
+    selected_thread = thread;
+    list.append(thread > 1 ? "," : "").append("{id=\"" + std::to_string(thread) + 
+        "\",target-id=\"Thread " + hex(0x7ffff7d8a000 + thread * 0x1000) + " (LWP " + 
+        std::to_string(getpid() + thread - 1) + ")\",name=\"" + (thread == 1 ? "mock" : "worker") + 
+        "\"," + (thread_running(thread) ? "state=\"running\"" : frame() + ",state=\"stopped\"") + ",core=\"0\"}");
+  }
+  selected_thread = selected;
+  result(token, "^done,threads=[" + list + "],current-thread-id=\"" + std::to_string(selected_thread) + "\"");
+}
+
+// Selects a thread, given the token of the command and whether MI asked for it;
+// GDB only notifies MI of selections made through the console.
+static void select_thread(const std::string & token, long thread, bool notify) {
+  if (thread < 1 || thread > scenario.threads) {
+    result(token, "^error,msg=" + quote("Invalid thread ID: " + std::to_string(thread)));
+    return;
+  }
+  selected_thread = thread;
+
+  // Running threads can be selected, but have no frame
+  std::string selected_frame = thread_running(thread) ? "" : "," + frame();
+  if (notify) {
+    std::cout << "=thread-selected,id=\"" << thread << "\"" << selected_frame << "\n";
+    result(token, "^done");
+  }
+  else {
+    result(token, "^done,new-thread-id=\"" + std::to_string(thread) + "\"" + selected_frame);
+  }
+}
+
+// Writes what info frame says about a frame, which ends where its caller starts.
+static void info_frame(long level) {
+  long frame_address = (long) stack.data() + (level + 1) * scenario.stack_size;
+  console("Stack level " + std::to_string(level) + ", frame at " + hex(frame_address) + ":\n" +
+      " rip = " + hex(program_counter()) + " in " + (level + 1 < scenario.frames ? "recurse" : "main") +
+      " (mock.c:" + std::to_string(line_number) + "); saved rip = " + hex(MOCK_FUNCTION_START) + "\n");
+}
+
+// Answers a console command, given the token of the MI command wrapping it.
+static void execute_console(const std::string & token, const std::string & command) {
+  std::string name = command.substr(0, command.find(' '));
+  if (name == "run" || name == "start") {
+    resume(token, true);
+  }
+  else if (name == "next" || name == "step" || name == "n" || name == "s") {
+    resume(token, false);
+  }
+  // The main thread continued in the background in non-stop mode keeps running,
+  // while the next worker hits a breakpoint
+  else if (command == "continue &" && non_stop && selected_thread == 1 && scenario.threads > 1) {
+    main_running = true;
+    std::cout << token << "^running\n*running,thread-id=\"1\"\n(gdb) \n";
+    if (stopped_worker) {
+      std::cout << "*running,thread-id=\"" << stopped_worker << "\"\n";
+    }
+    stopped_worker = stopped_worker % (scenario.threads - 1) + 2;
+    selected_thread = stopped_worker;
+    std::cout << "*stopped,reason=\"breakpoint-hit\",disp=\"keep\",bkptno=\"1\"," << frame() <<
+      ",thread-id=\"" << stopped_worker << "\",stopped-threads=[\"" << stopped_worker << "\"]\n" << std::flush;
+    selected_thread = 1;
+  }
+  // A worker continued in non-stop mode runs to its end and exits without stopping
+  else if ((name == "continue" || name == "c") && non_stop && selected_thread != 1) {
+    std::cout << token << "^running\n*running,thread-id=\"" << selected_thread << "\"\n(gdb) \n";
+    std::cout << "=thread-exited,id=\"" << selected_thread << "\",group-id=\"i1\"\n" << std::flush;
+  }
+  else if (command == "info locals") {
+    std::string locals;
+    for (long i = 0; i < scenario.locals; i++) {
+      locals.append("local_" + std::to_string(i) + " = " + std::to_string(local_value(i)) + "\n");
+    }
+    console(locals.empty() ? "No locals.\n" : locals);
+    result(token, "^done");
+  }
+  else if (command == "info args") {
+    console("argc = 1\nargv = 0x7fffffffe0a8\n");
+    result(token, "^done");
+  }
+  else if (command == "info registers") {
+    std::string registers;
+    for (size_t i = 0; i < mock_registers().size(); i++) {
+      if (!strcmp(mock_registers()[i].groups, MOCK_GENERAL_GROUPS)) {
+        char line[128];
+        snprintf(line, sizeof(line), "%-15s%-19s%s\n", mock_registers()[i].name.c_str(),
+            register_value(i, true).c_str(), register_value(i, false).c_str());
+        registers.append(line);
+      }
+    }
+    console(registers);
+    result(token, "^done");
+  }
+  else if (command == "maint print register-groups") {
+    std::string table = " Name         Nr  Rel Offset    Size  Type            Groups\n";
+    for (size_t i = 0; i < mock_registers().size(); i++) {
+      char line[160];
+      const std::string & name = mock_registers()[i].name;
+      bool vector = !name.compare(0, 3, "xmm");
+      snprintf(line, sizeof(line), " %-10s %4zu %4zu %6zu %5d %-15s %s\n", name.c_str(),
+          i, i, i * 8, vector ? 16 : name == "mxcsr" ? 4 : 8, vector ? "vec128" : "int64_t", mock_registers()[i].groups);
+      table.append(line);
+    }
+    console(table);
+    result(token, "^done");
+  }
+  else if (command == "disassemble") {
+    disassemble(token);
+  }
+  else if (command == "show listsize") {
+    console("Number of source lines gdb will list by default is 10.\n");
+    result(token, "^done");
+  }
+  else if (command == "show endian") {
+    console("The target endianness is set automatically (currently little endian).\n");
+    result(token, "^done");
+  }
+  else if (name == "list") {
+    // Listing is only exercised when there is no source file to map
+    long center = atol(command.c_str() + name.size());
+    std::string lines;
+    for (long line = std::max(1L, center - 9); line <= center + 9; line++) {
+      lines.append(std::to_string(line) + "\tint line_" + std::to_string(line) + ";\n");
+    }
+    console(lines);
+    result(token, "^done");
+  }
+  else if (!command.compare(0, strlen("whatis "), "whatis ") || !command.compare(0, strlen("ptype "), "ptype ")) {
+    if (command.find("values") == std::string::npos || command.find("_M_impl") != std::string::npos) {
+      result(token, "^error,msg=" + quote("No symbol in current context."));
+      return;
+    }
+    console("type = int\n");
+    result(token, "^done");
+  }
+  else if (command == "info frame") {
+    info_frame(frame_level);
+    result(token, "^done");
+  }
+  else if (!command.compare(0, strlen("frame apply "), "frame apply ")) {
+    long count = atol(command.c_str() + strlen("frame apply "));
+    for (long level = 0; level < std::min(count, scenario.frames); level++) {
+      info_frame(level);
+    }
+    result(token, "^done");
+  }
+  else if (name == "thread" && command.size() > name.size()) {
+    select_thread(token, atol(command.c_str() + name.size()), true);
+  }
+  else if (name == "up" || name == "down" || name == "frame" || name == "f") {
+    std::cout << "=thread-selected,id=\"" << selected_thread << "\"," << frame(name == "up" ? 1 : 0) << "\n";
+    result(token, "^done");
+  }
+  else if (!command.compare(0, strlen("set var "), "set var ")) {
+    std::cout << "=memory-changed,thread-group=\"i1\",addr=\"" << hex((long) stack.data()) << "\",len=\"0x4\"\n";
+    result(token, "^done");
+  }
+  else if (name == "set" || name == "break" || name == "b") {
+    result(token, "^done");
+  }
+  else {
+    result(token, "^error,msg=" + quote("Undefined command: \"" + name + "\"."));
+  }
+}
+
+// Answers -stack-list-frames with every frame, the outermost being main.
+static void list_frames(const std::string & token) {
+  std::string list;
+  for (long level = 0; level < scenario.frames; level++) {
+    list.append(level ? "," : "").append("frame={level=\"" + std::to_string(level) + "\",addr=\"" + 
+        hex(program_counter()) + "\",func=\"" + (level + 1 < scenario.frames ? "recurse" : "main") + 
+        "\",file=\"mock.c\",line=\"" + std::to_string(line_number) + "\"}");
+  }
+  result(token, "^done,stack=[" + list + "]");
+}
+
+// Takes the --thread and --frame options out of a command, keeping the frame.
+static std::string take_frame_options(const std::string & command) {
+  std::string stripped = command;
+  frame_level = 0;
+  for (const char * option : { " --thread ", " --frame " }) {
+    size_t start = stripped.find(option);
+    if (start == std::string::npos) {
+      continue;
+    }
+    size_t end = stripped.find(' ', start + strlen(option));
+    if (!strcmp(option, " --frame ")) {
+      frame_level = atol(stripped.c_str() + start + strlen(option));
+    }
+    stripped.erase(start, end == std::string::npos ? std::string::npos : end - start);
+  }
+  return stripped;
+}
+
+// Answers an MI command.
+static void execute(const std::string & token, const std::string & framed_command) {
+  std::string command = take_frame_options(framed_command);
+  if (!command.compare(0, strlen(MOCK_CONSOLE), MOCK_CONSOLE)) {
+    execute_console(token, unquote(command.substr(strlen(MOCK_CONSOLE))));
+  }
+  else if (command == "-stack-info-frame") {
+    result(token, running ? "^done," + frame() : "^error,msg=\"No stack.\"");
+  }
+  else if (!command.compare(0, strlen("-data-evaluate-expression"), "-data-evaluate-expression") &&
+      command.find("values") != std::string::npos && !values.empty()) {
+    evaluate_array(token, command);
+  }
+  else if (!command.compare(0, strlen("-data-evaluate-expression"), "-data-evaluate-expression") &&
+      frame_level >= scenario.frames) {
+    result(token, "^error,msg=" + quote("No frame at level " + std::to_string(frame_level) + "."));
+  }
+  else if (!command.compare(0, strlen("-data-evaluate-expression"), "-data-evaluate-expression")) {
+    long value = 0;
+    long stack_pointer = (long) stack.data() + frame_level * scenario.stack_size;
+    if (command.find("$sp") != std::string::npos) value = stack_pointer;
+    else if (command.find("$fp") != std::string::npos) value = stack_pointer + scenario.stack_size;
+    else if (command.find("$pc") != std::string::npos) value = program_counter();
+    result(token, "^done,value=\"" + std::to_string(value) + "\"");
+  }
+  else if (!command.compare(0, strlen("-data-read-memory-bytes"), "-data-read-memory-bytes")) {
+    read_memory(token, command.substr(strlen("-data-read-memory-bytes")));
+  }
+  else if (command == "-data-list-changed-registers") {
+    list_changed_registers(token);
+  }
+  else if (!command.compare(0, strlen("-data-list-register-values"), "-data-list-register-values")) {
+    list_register_values(token, command.substr(strlen("-data-list-register-values")));
+  }
+  else if (!command.compare(0, strlen("-stack-list-variables"), "-stack-list-variables")) {
+    list_variables(token);
+  }
+  else if (!command.compare(0, strlen("-var-create"), "-var-create")) {
+    create_variable(token, command.substr(strlen("-var-create")));
+  }
+  else if (!command.compare(0, strlen("-var-update"), "-var-update")) {
+    update_variables(token);
+  }
+  else if (!command.compare(0, strlen("-var-list-children"), "-var-list-children")) {
+    list_children(token, command.substr(strlen("-var-list-children")));
+  }
+  else if (!command.compare(0, strlen("-var-delete "), "-var-delete ")) {
+    delete_variable(token, command.substr(strlen("-var-delete ")));
+  }
+  else if (command == "-enable-pretty-printing") {
+    result(token, "^done");
+  }
+  else if (!command.compare(0, strlen("-stack-list-frames"), "-stack-list-frames")) {
+    list_frames(token);
+  }
+  else if (command == "-thread-info") {
+    list_threads(token);
+  }
+  else if (!command.compare(0, strlen("-thread-select "), "-thread-select ")) {
+    select_thread(token, atol(command.c_str() + strlen("-thread-select ")), false);
+  }
+  else if (!command.compare(0, strlen("-stack-select-frame "), "-stack-select-frame ")) {
+    result(token, "^done");
+  }
+  else if (command == "-gdb-show listsize") {
+    result(token, "^done,value=\"10\"");
+  }
+  else {
+    result(token, "^error,msg=" + quote("Undefined MI command: " + command));
+  }
+}
+
+// Replays a recorded reply if one matches the command.
+static bool replay(const std::string & token, const std::string & command) {
+  std::string console_command = !command.compare(0, strlen(MOCK_CONSOLE), MOCK_CONSOLE) ?
+    unquote(command.substr(strlen(MOCK_CONSOLE))) : command;
+
+  for (const MockReply & reply : scenario.transcript) {
+    if (console_command.compare(0, reply.prefix.size(), reply.prefix)) {
+      continue;
+    }
+
+    // Result records are given the command's token
+    for (const std::string & line : reply.lines) {
+      std::cout << (line[0] == '^' ? token : "") << line << "\n";
+    }
+    std::cout << "(gdb) \n" << std::flush;
+    return true;
+  }
+  return false;
+}
+
+// Loads a transcript: each "> prefix" line starts the reply to commands
+// beginning with the prefix, and the MI records up to the next one make it up.
+static void load_transcript(const char * path) {
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    if (line[0] == '>') {
+      MockReply reply;
+      reply.prefix = line.substr(line.find_first_not_of("> "));
+      scenario.transcript.push_back(reply);
+    }
+    else if (!scenario.transcript.empty()) {
+      scenario.transcript.back().lines.push_back(line);
+    }
+  }
+}
+
+static void remove_source() {
+  if (!source_path.empty()) {
+    unlink(source_path.c_str());
+  }
+}
+
+// Writes the source file frames point at, so that gg can map it.
+static void write_source() {
+  if (!scenario.source_lines) {
+    return;
+  }
+
+  source_path = "/tmp/mockgdb-" + std::to_string(getpid()) + ".c";
+  std::ofstream file(source_path);
+  for (long line = 1; line <= scenario.source_lines; line++) {
+    file << "  int line_" << line << " = " << line << ";\n";
+  }
+  atexit(remove_source);
+}
+
+int main(int argc, char ** argv) {
+  for (int i = 1; i < argc; i++) {
+    const char * arg = argv[i];
+    if (!strncmp(arg, MOCK_OPTION_DELAY, strlen(MOCK_OPTION_DELAY))) {
+      scenario.delay_us = atol(arg + strlen(MOCK_OPTION_DELAY));
+    }
+    else if (!strncmp(arg, MOCK_OPTION_LOCALS, strlen(MOCK_OPTION_LOCALS))) {
+      scenario.locals = atol(arg + strlen(MOCK_OPTION_LOCALS));
+    }
+    else if (!strncmp(arg, MOCK_OPTION_ARRAY_LENGTH, strlen(MOCK_OPTION_ARRAY_LENGTH))) {
+      scenario.array_length = atol(arg + strlen(MOCK_OPTION_ARRAY_LENGTH));
+    }
+    else if (!strncmp(arg, MOCK_OPTION_FUNCTION_SIZE, strlen(MOCK_OPTION_FUNCTION_SIZE))) {
+      scenario.function_size = std::max(1L, atol(arg + strlen(MOCK_OPTION_FUNCTION_SIZE)));
+    }
+    else if (!strncmp(arg, MOCK_OPTION_STACK_SIZE, strlen(MOCK_OPTION_STACK_SIZE))) {
+      scenario.stack_size = atol(arg + strlen(MOCK_OPTION_STACK_SIZE));
+    }
+    else if (!strncmp(arg, MOCK_OPTION_FRAMES, strlen(MOCK_OPTION_FRAMES))) {
+      scenario.frames = std::max(1L, atol(arg + strlen(MOCK_OPTION_FRAMES)));
+    }
+    else if (!strncmp(arg, MOCK_OPTION_THREADS, strlen(MOCK_OPTION_THREADS))) {
+      scenario.threads = std::max(1L, atol(arg + strlen(MOCK_OPTION_THREADS)));
+    }
+    else if (!strncmp(arg, MOCK_OPTION_SOURCE_LINES, strlen(MOCK_OPTION_SOURCE_LINES))) {
+      scenario.source_lines = atol(arg + strlen(MOCK_OPTION_SOURCE_LINES));
+    }
+    else if (!strncmp(arg, MOCK_OPTION_TRANSCRIPT, strlen(MOCK_OPTION_TRANSCRIPT))) {
+      load_transcript(arg + strlen(MOCK_OPTION_TRANSCRIPT));
+    }
+    else if (!strcmp(arg, MOCK_NON_STOP)) {
+      non_stop = true;
+    }
+  }
+
+  // The stack lives in this process so direct reads of it succeed, like they would
+  // for a real inferior; the extra space covers reads past the frame pointer
+  stack.resize(scenario.frames * scenario.stack_size + 64);
+  for (size_t i = 0; i < stack.size(); i++) {
+    stack[i] = (uint8_t) (i * 7);
+  }
+  for (long i = 0; i < scenario.array_length; i++) {
+    values.push_back(i);
+  }
+  write_source();
+
+  // gg may close the pipes before reading the reply to quit; exit normally so the source is removed
+  signal(SIGPIPE, SIG_IGN);
+
+  std::cout << "=thread-group-added,id=\"i1\"\n";
+  console("GNU gdb (mock) 13.1\n");
+  std::cout << "(gdb) \n" << std::flush;
+
+  std::string line;
+  while (std::getline(std::cin, line) && std::cout) {
+    size_t command_start = line.find_first_not_of("0123456789");
+    if (command_start == std::string::npos) {
+      continue;
+    }
+    std::string token = line.substr(0, command_start);
+    std::string command = line.substr(command_start);
+
+    if (scenario.delay_us) {
+      usleep(scenario.delay_us);
+    }
+
+    if (command == MOCK_CONSOLE "\"quit\"" || command == "-gdb-exit") {
+      std::cout << token << "^exit\n" << std::flush;
+      break;
+    }
+    if (!replay(token, command)) {
+      execute(token, command);
+    }
+  }
+
+  return 0;
+}
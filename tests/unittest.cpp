@@ -0,0 +1,252 @@
+// Checks the parts of gg that work without GDB or a display: the GDB/MI parser,
+// the line diff behind update_text(), the latency histogram, the names queries are
+// recorded under and snapshot sharing.
+// Usage: unittest
+// Prints every failed check and exits with a nonzero status if there was one.
+
+#include <cstring>
+#include <iostream>
+
+#include "../src/gg.hpp"
+
+// Number of checks that failed so far.
+static int failures = 0;
+
+// Reports a check that does not hold, without stopping the others.
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+      failures++; \
+    } \
+  } while (0)
+
+// Helper function for parsing a line of GDB/MI output given as a C string.
+static bool parse(const char * line, MIRecord & record) {
+  return parse_mi_record(line, strlen(line), record);
+}
+
+// Helper function for applying the replacement found by find_replaced_lines, checking
+// that it turns the shown text into the new value, and returning the lines replaced.
+static ReplacedLines replace(const std::string & shown, const std::string & value) {
+  size_t start, shown_end, value_end;
+  ReplacedLines replaced = find_replaced_lines(shown, value, start, shown_end, value_end);
+  CHECK(shown.substr(0, start) + value.substr(start, value_end - start) + shown.substr(shown_end) == value);
+  return replaced;
+}
+
+static void check_mi_parser() {
+  MIRecord record;
+
+  // Result records carry their token, class and results, nested to any depth
+  CHECK(parse("12^done,frame={level=\"0\",addr=\"0x401136\",func=\"main\"},"
+    "stack=[frame={level=\"0\"},frame={level=\"1\"}],ids=[\"1\",\"2\"]", record));
+  CHECK(record.type == MI_RECORD_RESULT);
+  CHECK(record.token == 12);
+  CHECK(record.record_class == "done");
+  CHECK(record.results["frame"].kind == MIValue::MI_TUPLE);
+  CHECK(record.results["frame"]["func"].string == "main");
+  CHECK(record.results["frame"]["addr"].to_long(0) == 0x401136);
+  CHECK(record.results["stack"].kind == MIValue::MI_LIST);
+  CHECK(record.results["stack"].size() == 2);
+  CHECK(record.results["stack"][1]["level"].to_long(-1) == 1);
+  CHECK(record.results["ids"][1].to_long(0) == 2);
+  CHECK(!record.results.has("missing"));
+  CHECK(record.results["missing"].to_long(7) == 7);
+
+  // Records without a token, and empty lists
+  CHECK(parse("^error,msg=\"No symbol \\\"x\\\" in current context.\"", record));
+  CHECK(record.token == -1);
+  CHECK(record.record_class == "error");
+  CHECK(record.results["msg"].string == "No symbol \"x\" in current context.");
+  CHECK(parse("^done,threads=[]", record));
+  CHECK(record.results["threads"].kind == MIValue::MI_LIST);
+  CHECK(record.results["threads"].size() == 0);
+
+  // Asynchronous records
+  CHECK(parse("*stopped,reason=\"end-stepping-range\",thread-id=\"1\",stopped-threads=\"all\"", record));
+  CHECK(record.type == MI_RECORD_EXEC);
+  CHECK(record.record_class == "stopped");
+  CHECK(record.results["stopped-threads"].kind == MIValue::MI_CONST);
+  CHECK(parse("=thread-exited,id=\"3\",group-id=\"i1\"", record));
+  CHECK(record.type == MI_RECORD_NOTIFY);
+  CHECK(record.results["id"].to_long(0) == 3);
+
+  // Stream records hold their unescaped text in the class
+  CHECK(parse("~\"rax            0x1c                28\\n\"", record));
+  CHECK(record.type == MI_RECORD_CONSOLE);
+  CHECK(record.record_class == "rax            0x1c                28\n");
+  CHECK(parse("&\"warning\\t\\\"x\\\"\\n\"", record));
+  CHECK(record.type == MI_RECORD_LOG);
+  CHECK(record.record_class == "warning\t\"x\"\n");
+
+  // The prompt, and output of the inferior that is not a record
+  CHECK(parse("(gdb) ", record));
+  CHECK(record.type == MI_RECORD_PROMPT);
+  CHECK(!parse("Hello, world!", record));
+  CHECK(!parse("", record));
+
+  // Quoting escapes what the parser unescapes
+  std::string quoted = "~" + mi_quote("a \"b\"\\\n");
+  CHECK(parse(quoted.c_str(), record));
+  CHECK(record.record_class == "a \"b\"\\\n");
+}
+
+static void check_update_text() {
+  // A line changed in the middle
+  ReplacedLines replaced = replace("a\nb\nc\n", "a\nx\nc\n");
+  CHECK(replaced.first == 1);
+  CHECK(replaced.end == 2);
+  CHECK(!replaced.shifted);
+
+  // Lines added or removed move the ones after them
+  replaced = replace("a\nb\nc\n", "a\nb\nx\ny\nc\n");
+  CHECK(replaced.first == 2);
+  CHECK(replaced.shifted);
+  replaced = replace("a\nb\nc\n", "a\nc\n");
+  CHECK(replaced.first == 1);
+  CHECK(replaced.shifted);
+
+  // The last line may not end with a newline
+  replaced = replace("a\nb", "a\nc");
+  CHECK(replaced.first == 1);
+  CHECK(replaced.end == 2);
+  CHECK(!replaced.shifted);
+
+  // Lines that only share a prefix or suffix are replaced whole
+  replaced = replace("abc\nxyz\n", "abd\nxyz\n");
+  CHECK(replaced.first == 0);
+  CHECK(replaced.end == 1);
+  replaced = replace("one\n", "");
+  CHECK(replaced.first == 0);
+  replace("", "one\ntwo\n");
+  replace("same\nprefix\n", "same\nprefix\nand more\n");
+}
+
+static void check_histogram() {
+  // Small values each have a bucket of their own
+  LatencyHistogram small;
+  for (uint64_t value = 1; value <= 10; value++) {
+    small.record(value);
+  }
+  CHECK(small.count() == 10);
+  CHECK(small.min() == 1);
+  CHECK(small.max() == 10);
+  CHECK(small.percentile(50) == 5);
+  CHECK(small.percentile(100) == 10);
+
+  // Larger values are within the precision of their bucket
+  LatencyHistogram large;
+  for (uint64_t value = 1; value <= 100000; value++) {
+    large.record(value);
+  }
+  uint64_t tolerance = 100000 >> GG_HISTOGRAM_PRECISION_BITS;
+  CHECK(large.percentile(50) + tolerance / 2 >= 50000 && large.percentile(50) <= 50000 + tolerance / 2);
+  CHECK(large.percentile(99) + tolerance >= 99000 && large.percentile(99) <= 99000 + tolerance);
+  CHECK(large.percentile(100) <= 100000);
+
+  // Values straddling a power of two land in different buckets
+  LatencyHistogram powers;
+  powers.record(1023);
+  powers.record(1 << 20);
+  CHECK(powers.percentile(50) < 1100);
+  CHECK(powers.percentile(100) > 1000000);
+
+  // Nothing recorded
+  LatencyHistogram empty;
+  CHECK(empty.percentile(50) == 0);
+  CHECK(empty.min() == 0);
+}
+
+static void check_query_names() {
+  // Commands are named without their options and arguments, so each has one entry
+  CHECK(query_name("-var-create - @ \"local_0\"") == "-var-create");
+  CHECK(query_name("-var-update --all-values *") == "-var-update");
+  CHECK(query_name("-data-list-register-values --skip-unavailable x 17 18") == "-data-list-register-values");
+  CHECK(query_name(mi_in_frame("-stack-list-variables --no-values", 2, 1)) == "-stack-list-variables");
+  CHECK(query_name(mi_in_frame(mi_console("info frame"), 2, 1)) == "info frame");
+  CHECK(query_name(mi_console("info registers")) == "info registers");
+  CHECK(query_name("x/16xb $sp") == "x");
+  CHECK(query_name("list 12") == "list");
+  CHECK(query_name("maint print register-groups") == "maint print register-groups");
+  CHECK(query_name(mi_console("frame apply 4096 -q info frame")) == "frame apply");
+  CHECK(query_name("set listsize 19") == "set listsize");
+
+  // Other commands are named by their first word, so that each has one entry whatever it is given
+  CHECK(query_name("print foo") == "print");
+  CHECK(query_name("ptype struct s") == "ptype");
+  CHECK(query_name("p x") == "p");
+  CHECK(query_name(mi_console("info breakpoints")) == "info");
+}
+
+static void check_snapshots() {
+  StopInfo info = StopInfo();
+  info.status = "running";
+  info.source_code = "1\tint main() {\n";
+  info.registers = "rax 0x1 1\n";
+  info.threads = { InferiorThread() };
+  info.thread = 1;
+  info.panels = GG_PANEL_SOURCE | GG_PANEL_ASSEMBLY | GG_PANEL_THREADS;
+  DebugSnapshotPtr first = make_snapshot(nullptr, info);
+  CHECK(*first->source_code == "1\tint main() {\n");
+  CHECK(first->threads->size() == 1);
+  CHECK(!first->stack_frame);
+
+  // Sections that did not change are shared, the others replaced
+  info = StopInfo();
+  info.status = "running";
+  info.source_code = "1\tint main() {\n";
+  info.registers = "rax 0x2 2\n";
+  info.thread = 1;
+  info.panels = GG_PANEL_SOURCE | GG_PANEL_ASSEMBLY;
+  DebugSnapshotPtr second = make_snapshot(first, info);
+  CHECK(second->status == first->status);
+  CHECK(second->source_code == first->source_code);
+  CHECK(second->registers != first->registers);
+  CHECK(*second->registers == "rax 0x2 2\n");
+
+  // Sections that were not queried are carried over
+  CHECK(second->threads == first->threads);
+
+  // A cached snapshot shows its own frame with the latest thread list and status
+  info = StopInfo();
+  info.status = "stopped";
+  info.threads = { InferiorThread(), InferiorThread() };
+  info.panels = GG_PANEL_THREADS;
+  DebugSnapshotPtr latest = make_snapshot(second, info);
+  DebugSnapshotPtr reused = reuse_snapshot(first, latest);
+  CHECK(reused->registers == first->registers);
+  CHECK(reused->threads == latest->threads);
+  CHECK(*reused->status == "stopped");
+
+  // Cached snapshots are found until their thread or every thread runs again
+  SnapshotCache cache;
+  int panels = -1;
+  CHECK(!cache.find(1, 1, 1, 0, panels));
+  CHECK(panels == 0);
+  cache.store(1, 1, 0, GG_PANEL_SOURCE, first);
+  CHECK(cache.find(1, 1, 1, 0, panels) == first);
+  CHECK(panels == GG_PANEL_SOURCE);
+  CHECK(!cache.find(1, 1, 2, 0, panels));
+  CHECK(!cache.find(1, 1, 1, 1, panels));
+  CHECK(!cache.find(1, 2, 1, 0, panels));
+  cache.drop_panels(GG_PANEL_SOURCE);
+  CHECK(cache.find(1, 1, 1, 0, panels) == first);
+  CHECK(panels == 0);
+  CHECK(!cache.find(2, 1, 1, 0, panels));
+  CHECK(!cache.find(1, 1, 1, 0, panels));
+}
+
+int main() {
+  check_mi_parser();
+  check_update_text();
+  check_histogram();
+  check_query_names();
+  check_snapshots();
+
+  if (failures) {
+    std::cerr << failures << " checks failed" << std::endl;
+    return 1;
+  }
+  std::cout << "All checks passed" << std::endl;
+  return 0;
+}